@@ -0,0 +1,271 @@
+// avrahamavitan@gmail.com
+#include "Alloc.hpp"
+#include "Profile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <sys/mman.h>
+
+namespace mat {
+
+// Bookkeeping stored in the VALUE_ALIGN bytes just before every block
+struct BlockHeader {
+    void* base;        // start of the allocation
+    size_t length;     // bytes mapped (huge blocks only)
+    int kind;          // AllocPolicy the block was made with
+    bool tracked;      // allocated while tracking was on
+    int generation;    // tracking reset it was counted under
+    const char* site;  // AllocSite charged, when tracked
+    size_t bytes;      // requested size, when tracked
+    double born;       // allocation time in seconds, when tracked
+};
+
+static_assert(sizeof(BlockHeader) <= VALUE_ALIGN, "Header must fit before the block");
+
+// Policy named by SQUAREMAT_ALLOC, default huge
+static AllocPolicy initialPolicy() {
+    const char* env = std::getenv("SQUAREMAT_ALLOC");
+    if (env && std::strcmp(env, "plain") == 0) return ALLOC_PLAIN;
+    if (env && std::strcmp(env, "aligned") == 0) return ALLOC_ALIGNED;
+    return ALLOC_HUGE;
+}
+
+static std::atomic<int> policy(initialPolicy());
+
+// Current policy
+AllocPolicy allocPolicy() {
+    return static_cast<AllocPolicy>(policy.load());
+}
+
+// Change the policy for later blocks
+void setAllocPolicy(AllocPolicy next) {
+    policy = next;
+}
+
+// THP mode is "[always]" or "[madvise]" unless disabled; read once
+bool hugePagesAvailable() {
+    static const bool available = []() {
+        std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string line;
+        if (!file || !std::getline(file, line)) return false;
+        return line.find("[never]") == std::string::npos;
+    }();
+    return available;
+}
+
+// Header of a block
+static BlockHeader* headerOf(const double* block) {
+    return reinterpret_cast<BlockHeader*>(const_cast<char*>(reinterpret_cast<const char*>(block) - VALUE_ALIGN));
+}
+
+// ---------- allocation tracking ----------
+
+// Off unless asked for in the environment
+static std::atomic<bool> tracking(std::getenv("SQUAREMAT_TRACK_ALLOC") != nullptr &&
+                                  std::atoi(std::getenv("SQUAREMAT_TRACK_ALLOC")) != 0);
+
+static std::atomic<long long> live(0), blocks(0), peak(0);
+static int generation = 0;                        // bumped by each reset, guarded by trackLock
+static std::map<std::string, SiteStats> sites;    // guarded by trackLock
+static std::vector<Temporary> temporaries;        // largest first, guarded by trackLock
+static std::mutex trackLock;
+static thread_local const char* currentSite = nullptr;
+
+// Seconds on a monotonic clock
+static double clockSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Is tracking on
+bool allocTrackingEnabled() {
+    return tracking.load(std::memory_order_relaxed);
+}
+
+// Turn tracking on or off
+void setAllocTracking(bool on) {
+    tracking = on;
+}
+
+// Zero every counter
+void resetAllocTracking() {
+    std::lock_guard<std::mutex> guard(trackLock);
+    ++generation; // blocks counted before this no longer affect the counters
+    live = 0;
+    blocks = 0;
+    peak = 0;
+    sites.clear();
+    temporaries.clear();
+}
+
+// Charge a new block to the thread's site and raise the peak if needed
+static void trackAllocation(BlockHeader* header, size_t bytes) {
+    header->tracked = allocTrackingEnabled();
+    if (!header->tracked) return;
+    header->site = currentSite ? currentSite : "(none)";
+    header->bytes = bytes;
+    header->born = clockSeconds();
+    long long size = static_cast<long long>(bytes);
+    std::lock_guard<std::mutex> guard(trackLock);
+    header->generation = generation;
+    long long now = live += size;
+    ++blocks;
+    if (now > peak) peak = now;
+    SiteStats& s = sites[header->site];
+    ++s.allocations;
+    s.bytes += size;
+    if (size > s.largest) s.largest = size;
+}
+
+// Retire a tracked block and keep it if it is among the largest temporaries
+static void trackFree(const BlockHeader* header) {
+    if (!header->tracked) return;
+    Temporary t = {header->site, static_cast<long long>(header->bytes), clockSeconds() - header->born};
+    std::lock_guard<std::mutex> guard(trackLock);
+    if (header->generation != generation) return; // counted before the last reset
+    live -= t.bytes;
+    --blocks;
+    if (static_cast<int>(temporaries.size()) == TOP_TEMPORARIES && temporaries.back().bytes >= t.bytes) return;
+    std::vector<Temporary>::iterator at = temporaries.begin();
+    while (at != temporaries.end() && at->bytes >= t.bytes) ++at;
+    temporaries.insert(at, t);
+    if (static_cast<int>(temporaries.size()) > TOP_TEMPORARIES) temporaries.pop_back();
+}
+
+// Bytes in tracked blocks not yet freed
+long long liveBytes() {
+    return live.load();
+}
+
+// Tracked blocks not yet freed
+long long liveBlocks() {
+    return blocks.load();
+}
+
+// Highest live bytes since the reset
+long long peakBytes() {
+    return peak.load();
+}
+
+// Copy of the per-site counters
+std::map<std::string, SiteStats> allocationsBySite() {
+    std::lock_guard<std::mutex> guard(trackLock);
+    return sites;
+}
+
+// Copy of the largest freed blocks
+std::vector<Temporary> largestTemporaries() {
+    std::lock_guard<std::mutex> guard(trackLock);
+    return temporaries;
+}
+
+// Everything as JSON
+std::string allocationReport() {
+    std::lock_guard<std::mutex> guard(trackLock);
+    std::ostringstream out;
+    out << "{\"live_bytes\": " << live.load() << ", \"live_blocks\": " << blocks.load()
+        << ", \"peak_bytes\": " << peak.load() << ",\n \"sites\": [";
+    bool first = true;
+    for (std::map<std::string, SiteStats>::const_iterator it = sites.begin(); it != sites.end(); ++it) {
+        out << (first ? "" : ",") << "\n  {\"site\": \"" << it->first << "\", \"allocations\": " << it->second.allocations
+            << ", \"bytes\": " << it->second.bytes << ", \"largest\": " << it->second.largest << "}";
+        first = false;
+    }
+    out << "],\n \"largest_temporaries\": [";
+    for (size_t i = 0; i < temporaries.size(); ++i)
+        out << (i ? "," : "") << "\n  {\"site\": \"" << temporaries[i].site << "\", \"bytes\": " << temporaries[i].bytes
+            << ", \"seconds\": " << temporaries[i].seconds << "}";
+    out << "]}";
+    return out.str();
+}
+
+// Site of the calling thread
+const char* allocSite() {
+    return currentSite;
+}
+
+// Enter a named site
+AllocSite::AllocSite(const char* name) : outer(currentSite) {
+    currentSite = name;
+}
+
+// Back to the enclosing site
+AllocSite::~AllocSite() {
+    currentSite = outer;
+}
+
+// ---------- allocation ----------
+
+// Heap block with room for the header; aligned unless plain
+static double* heapBlock(size_t bytes, AllocPolicy kind) {
+    void* base = nullptr;
+    if (kind == ALLOC_PLAIN) {
+        base = std::malloc(bytes + VALUE_ALIGN);
+    } else if (posix_memalign(&base, VALUE_ALIGN, bytes + VALUE_ALIGN) != 0) {
+        base = nullptr;
+    }
+    if (!base) throw std::bad_alloc();
+    double* block = reinterpret_cast<double*>(static_cast<char*>(base) + VALUE_ALIGN);
+    BlockHeader* header = headerOf(block);
+    header->base = base;
+    header->length = 0;
+    header->kind = kind;
+    return block;
+}
+
+// Mapping that starts on a huge-page boundary: map one huge page extra,
+// then unmap the unaligned head and the unused tail. Null if mmap fails.
+static double* hugeBlock(size_t bytes) {
+    size_t length = (bytes + VALUE_ALIGN + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    void* mapped = mmap(nullptr, length + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) return nullptr;
+    uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+    uintptr_t aligned = (start + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    if (aligned > start) munmap(mapped, aligned - start);
+    size_t tail = (start + length + HUGE_PAGE) - (aligned + length);
+    if (tail > 0) munmap(reinterpret_cast<void*>(aligned + length), tail);
+    void* base = reinterpret_cast<void*>(aligned);
+    madvise(base, length, MADV_HUGEPAGE); // advice only: small pages still work
+    double* block = reinterpret_cast<double*>(aligned + VALUE_ALIGN);
+    BlockHeader* header = headerOf(block);
+    header->base = base;
+    header->length = length;
+    header->kind = ALLOC_HUGE;
+    return block;
+}
+
+// Allocate under the current policy, falling back from huge pages to aligned
+double* allocValues(size_t count) {
+    if (count > (SIZE_MAX - HUGE_PAGE) / sizeof(double)) throw std::bad_alloc(); // bytes would wrap
+    size_t bytes = count * sizeof(double);
+    profileAllocation(bytes);
+    AllocPolicy kind = allocPolicy();
+    double* block = nullptr;
+    if (kind == ALLOC_HUGE && bytes >= HUGE_PAGE && hugePagesAvailable())
+        block = hugeBlock(bytes);
+    if (!block) block = heapBlock(bytes, kind == ALLOC_HUGE ? ALLOC_ALIGNED : kind); // small, or no huge pages here
+    trackAllocation(headerOf(block), bytes);
+    return block;
+}
+
+// Release a block the way it was allocated
+void freeValues(double* block) {
+    if (!block) return;
+    BlockHeader* header = headerOf(block);
+    trackFree(header);
+    if (header->kind == ALLOC_HUGE) munmap(header->base, header->length);
+    else std::free(header->base);
+}
+
+// Kind recorded in the header
+AllocPolicy allocKind(const double* block) {
+    return static_cast<AllocPolicy>(headerOf(block)->kind);
+}
+
+} // namespace mat
@@ -0,0 +1,95 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mat {
+
+// How value blocks are allocated
+enum AllocPolicy {
+    ALLOC_PLAIN,     // heap, default alignment
+    ALLOC_ALIGNED,   // heap, VALUE_ALIGN-byte aligned
+    ALLOC_HUGE       // aligned; blocks of HUGE_PAGE bytes and up are mapped
+                     // on huge-page boundaries and advised MADV_HUGEPAGE
+};
+
+static const size_t VALUE_ALIGN = 64;        // one cache line, full-width SIMD loads; block start only
+static const size_t HUGE_PAGE = 2 << 20;     // 2 MB transparent huge pages
+
+// Current policy. Starts from SQUAREMAT_ALLOC ("plain", "aligned" or "huge"),
+// default huge; setAllocPolicy affects blocks allocated afterwards.
+AllocPolicy allocPolicy();
+void setAllocPolicy(AllocPolicy policy);
+
+// True if the kernel offers transparent huge pages to madvise callers.
+// Without them ALLOC_HUGE falls back to ALLOC_ALIGNED.
+bool hugePagesAvailable();
+
+// Uninitialized block of count doubles under the current policy; the block
+// remembers how it was made, so freeValues works whatever the policy is now.
+// Throws std::bad_alloc when out of memory.
+double* allocValues(size_t count);
+void freeValues(double* block);
+
+// Policy a block was actually allocated with (after any fallback)
+AllocPolicy allocKind(const double* block);
+
+// ---------- allocation tracking ----------
+
+// Tracking is off unless SQUAREMAT_TRACK_ALLOC=1 or setAllocTracking(true).
+// Only blocks allocated while it is on are counted, so live bytes never go
+// negative. Each block is charged to the innermost AllocSite of the thread
+// that allocated it; every SquareMat operator opens one named after itself.
+// Pool tasks (parallelFor chunks, TaskGroup tasks, submit) run under the site
+// that was current where they were created, whichever thread runs them.
+bool allocTrackingEnabled();
+void setAllocTracking(bool on);
+void resetAllocTracking();        // zero the counters; live blocks stay untracked
+
+// Allocations charged to one site
+struct SiteStats {
+    long long allocations;
+    long long bytes;
+    long long largest;            // biggest single block
+};
+
+// A freed block, kept among the largest seen
+struct Temporary {
+    std::string site;
+    long long bytes;
+    double seconds;               // lifetime
+};
+
+static const int TOP_TEMPORARIES = 8;   // temporaries kept by largestTemporaries
+
+long long liveBytes();
+long long liveBlocks();
+long long peakBytes();                              // highest liveBytes since the reset
+std::map<std::string, SiteStats> allocationsBySite();   // "(none)" outside any site
+std::vector<Temporary> largestTemporaries();        // largest first
+
+// Counters above as one JSON object
+std::string allocationReport();
+
+// Innermost site of the calling thread, null outside any
+const char* allocSite();
+
+// AllocSite: names the allocations made by this thread while it exists.
+// name must outlive the tracker's counters (a string literal); a null name
+// means no site, so allocations go to "(none)".
+class AllocSite {
+private:
+    const char* outer;            // enclosing site, restored on destruction
+
+public:
+    explicit AllocSite(const char* name);
+    AllocSite(const AllocSite&) = delete;
+    AllocSite& operator=(const AllocSite&) = delete;
+    ~AllocSite();
+};
+
+} // namespace mat
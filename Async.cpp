@@ -0,0 +1,25 @@
+// avrahamavitan@gmail.com
+#include "Async.hpp"
+#include "Parallel.hpp"
+
+namespace mat {
+
+// a * b on a pool worker
+std::future<SquareMat> multiply_async(const SquareMat& a, const SquareMat& b) {
+    SquareMat left(a), right(b);
+    return ThreadPool::instance().submit([left, right]() { return left * right; });
+}
+
+// a ^ power on a pool worker
+std::future<SquareMat> power_async(const SquareMat& a, int power) {
+    SquareMat base(a);
+    return ThreadPool::instance().submit([base, power]() { return base ^ power; });
+}
+
+// !a on a pool worker
+std::future<double> determinant_async(const SquareMat& a) {
+    SquareMat m(a);
+    return ThreadPool::instance().submit([m]() { return !m; });
+}
+
+} // namespace mat
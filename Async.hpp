@@ -0,0 +1,17 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include <future>
+
+namespace mat {
+
+// Asynchronous versions of the heavy operators, run on the library thread pool.
+// The arguments are copied up front (O(1) with copy-on-write), so the caller may
+// change its matrices while the work is in flight.
+std::future<SquareMat> multiply_async(const SquareMat& a, const SquareMat& b);   // a * b
+std::future<SquareMat> power_async(const SquareMat& a, int power);               // a ^ power
+std::future<double> determinant_async(const SquareMat& a);                       // !a
+
+} // namespace mat
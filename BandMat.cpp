@@ -0,0 +1,345 @@
+// avrahamavitan@gmail.com
+#include "BandMat.hpp"
+#include <cmath>
+#include <algorithm>
+
+using namespace mat;
+
+// ---------- BandMat ----------
+
+// Constructor: create n x n zero band matrix
+BandMat::BandMat(int n, int kl, int ku) : size(n), kl(kl), ku(ku) {
+    if (n <= 0) throw std::invalid_argument("Invalid matrix size");
+    if (kl < 0 || ku < 0 || kl >= n || ku >= n) throw std::invalid_argument("Invalid bandwidth");
+    data = new double[size * width()]();
+}
+
+// Build from the band of a SquareMat
+BandMat::BandMat(const SquareMat& mat, int kl, int ku) : BandMat(mat.dim(), kl, ku) {
+    for (int i = 0; i < size; ++i) {
+        const double* row = mat[i];
+        int j0 = (i - kl > 0) ? i - kl : 0;
+        int j1 = (i + ku < size - 1) ? i + ku : size - 1;
+        for (int j = j0; j <= j1; ++j) at(i, j) = row[j];
+    }
+}
+
+// Copy values from other matrix
+void BandMat::copy(const BandMat& other) {
+    size = other.size;
+    kl = other.kl;
+    ku = other.ku;
+    data = new double[size * width()];
+    for (int i = 0; i < size * width(); ++i) data[i] = other.data[i];
+}
+
+// Copy constructor
+BandMat::BandMat(const BandMat& other) {
+    copy(other);
+}
+
+// Assignment operator: clean old data and copy new data
+BandMat& BandMat::operator=(const BandMat& other) {
+    if (this != &other) {
+        delete[] data;
+        copy(other);
+    }
+    return *this;
+}
+
+// Destructor: free memory
+BandMat::~BandMat() {
+    delete[] data;
+}
+
+// Stored values per row
+int BandMat::width() const {
+    return kl + ku + 1;
+}
+
+// Band membership
+bool BandMat::inside(int row, int col) const {
+    return col - row >= -kl && col - row <= ku;
+}
+
+// Unchecked access (const)
+double BandMat::at(int row, int col) const {
+    return data[row * width() + col - row + kl];
+}
+
+// Unchecked access (non-const)
+double& BandMat::at(int row, int col) {
+    return data[row * width() + col - row + kl];
+}
+
+// Matrix dimension
+int BandMat::dim() const {
+    return size;
+}
+
+// Sub-diagonal count
+int BandMat::lower() const {
+    return kl;
+}
+
+// Super-diagonal count
+int BandMat::upper() const {
+    return ku;
+}
+
+// Read one entry
+double BandMat::get(int row, int col) const {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    return inside(row, col) ? at(row, col) : 0;
+}
+
+// Write one entry inside the band
+void BandMat::set(int row, int col, double value) {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    if (!inside(row, col)) throw std::invalid_argument("Entry outside the band");
+    at(row, col) = value;
+}
+
+// Expand to a full matrix
+SquareMat BandMat::toSquareMat() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i) {
+        int j0 = (i - kl > 0) ? i - kl : 0;
+        int j1 = (i + ku < size - 1) ? i + ku : size - 1;
+        double* row = out + static_cast<size_t>(i) * size;
+        for (int j = j0; j <= j1; ++j) row[j] = at(i, j);
+    }
+    return result;
+}
+
+// Add: result band covers both bands
+BandMat BandMat::operator+(const BandMat& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    BandMat result(size, std::max(kl, other.kl), std::max(ku, other.ku));
+    for (int i = 0; i < size; ++i)
+        for (int j = std::max(0, i - result.kl); j <= std::min(size - 1, i + result.ku); ++j)
+            result.at(i, j) = get(i, j) + other.get(i, j);
+    return result;
+}
+
+// Subtract: result band covers both bands
+BandMat BandMat::operator-(const BandMat& other) const {
+    return *this + (-other);
+}
+
+// Unary minus: negate each stored entry
+BandMat BandMat::operator-() const {
+    BandMat result(*this);
+    for (int i = 0; i < size * width(); ++i) result.data[i] = -data[i];
+    return result;
+}
+
+// Multiply: (kl1 + kl2, ku1 + ku2) band, only k inside both bands contribute
+BandMat BandMat::operator*(const BandMat& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    BandMat result(size, std::min(kl + other.kl, size - 1), std::min(ku + other.ku, size - 1));
+    for (int i = 0; i < size; ++i) {
+        int k0 = std::max(0, i - kl), k1 = std::min(size - 1, i + ku);
+        for (int k = k0; k <= k1; ++k) {
+            double aik = at(i, k); // zeros inside the band are not skipped: 0 * Inf is NaN
+            int j0 = std::max(0, k - other.kl), j1 = std::min(size - 1, k + other.ku);
+            for (int j = j0; j <= j1; ++j) result.at(i, j) += aik * other.at(k, j);
+        }
+    }
+    return result;
+}
+
+// Scalar multiplication
+BandMat BandMat::operator*(double scalar) const {
+    BandMat result(*this);
+    for (int i = 0; i < size * width(); ++i) result.data[i] *= scalar;
+    return result;
+}
+
+// Power by repeated squaring; the band widens with each product
+BandMat BandMat::operator^(int power) const {
+    if (power < 0) throw std::invalid_argument("Negative powers not supported");
+    BandMat result(size, 0, 0);
+    for (int i = 0; i < size; ++i) result.at(i, i) = 1; // identity
+    BandMat base(*this);
+    while (power) {
+        if (power % 2) result = result * base;
+        power /= 2;
+        if (power) base = base * base;
+    }
+    return result;
+}
+
+// Transpose: swap the sub- and super-diagonals
+BandMat BandMat::operator~() const {
+    BandMat result(size, ku, kl);
+    for (int i = 0; i < size; ++i)
+        for (int j = std::max(0, i - kl); j <= std::min(size - 1, i + ku); ++j)
+            result.at(j, i) = at(i, j);
+    return result;
+}
+
+// Determinant by banded LU with partial pivoting. Row swaps widen the upper
+// band to kl + ku, so each working row r holds columns r-kl .. r+kl+ku.
+double BandMat::operator!() const {
+    int w = 2 * kl + ku + 1;
+    double* lu = new double[size * w]();
+    for (int i = 0; i < size; ++i)
+        for (int j = std::max(0, i - kl); j <= std::min(size - 1, i + ku); ++j)
+            lu[i * w + j - i + kl] = at(i, j);
+    double det = 1;
+    for (int k = 0; k < size; ++k) {
+        int last = std::min(size - 1, k + kl);       // last row with a nonzero in column k
+        int right = std::min(size - 1, k + kl + ku); // last column touched by row k
+        int p = k;
+        for (int i = k + 1; i <= last; ++i)
+            if (std::fabs(lu[i * w + k - i + kl]) > std::fabs(lu[p * w + k - p + kl])) p = i;
+        if (p != k) {
+            for (int j = k; j <= right; ++j) {
+                double tmp = lu[k * w + j - k + kl];
+                lu[k * w + j - k + kl] = lu[p * w + j - p + kl];
+                lu[p * w + j - p + kl] = tmp;
+            }
+            det = -det;
+        }
+        double pivot = lu[k * w + kl];
+        det *= pivot;
+        if (pivot == 0) break; // singular
+        for (int i = k + 1; i <= last; ++i) {
+            double factor = lu[i * w + k - i + kl] / pivot;
+            if (factor == 0) continue;
+            for (int j = k + 1; j <= right; ++j)
+                lu[i * w + j - i + kl] -= factor * lu[k * w + j - k + kl];
+        }
+    }
+    delete[] lu;
+    return det;
+}
+
+// ---------- DiagMat ----------
+
+// Constructor: create n x n zero matrix
+DiagMat::DiagMat(int n) : size(n) {
+    if (n <= 0) throw std::invalid_argument("Invalid matrix size");
+    data = new double[size]();
+}
+
+// Copy values from other matrix
+void DiagMat::copy(const DiagMat& other) {
+    size = other.size;
+    data = new double[size];
+    for (int i = 0; i < size; ++i) data[i] = other.data[i];
+}
+
+// Copy constructor
+DiagMat::DiagMat(const DiagMat& other) {
+    copy(other);
+}
+
+// Assignment operator: clean old data and copy new data
+DiagMat& DiagMat::operator=(const DiagMat& other) {
+    if (this != &other) {
+        delete[] data;
+        copy(other);
+    }
+    return *this;
+}
+
+// Destructor: free memory
+DiagMat::~DiagMat() {
+    delete[] data;
+}
+
+// Matrix dimension
+int DiagMat::dim() const {
+    return size;
+}
+
+// Access diagonal entry (non-const)
+double& DiagMat::operator[](int index) {
+    if (index < 0 || index >= size) throw std::out_of_range("Index out of range");
+    return data[index];
+}
+
+// Access diagonal entry (const version)
+double DiagMat::operator[](int index) const {
+    if (index < 0 || index >= size) throw std::out_of_range("Index out of range");
+    return data[index];
+}
+
+// Expand to a full matrix
+SquareMat DiagMat::toSquareMat() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i) out[static_cast<size_t>(i) * size + i] = data[i];
+    return result;
+}
+
+// Add diagonals
+DiagMat DiagMat::operator+(const DiagMat& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    DiagMat result(size);
+    for (int i = 0; i < size; ++i) result.data[i] = data[i] + other.data[i];
+    return result;
+}
+
+// Subtract diagonals
+DiagMat DiagMat::operator-(const DiagMat& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    DiagMat result(size);
+    for (int i = 0; i < size; ++i) result.data[i] = data[i] - other.data[i];
+    return result;
+}
+
+// Unary minus
+DiagMat DiagMat::operator-() const {
+    return *this * -1.0;
+}
+
+// Multiply diagonals entry by entry
+DiagMat DiagMat::operator*(const DiagMat& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    DiagMat result(size);
+    for (int i = 0; i < size; ++i) result.data[i] = data[i] * other.data[i];
+    return result;
+}
+
+// Scalar multiplication
+DiagMat DiagMat::operator*(double scalar) const {
+    DiagMat result(size);
+    for (int i = 0; i < size; ++i) result.data[i] = data[i] * scalar;
+    return result;
+}
+
+// D * B: scale each row of b, O(n^2)
+SquareMat DiagMat::operator*(const SquareMat& b) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    SquareMat result(b);
+    double* out = KernelAccess::values(result); // private copy of b's values
+    for (int i = 0; i < size; ++i) {
+        double* row = out + static_cast<size_t>(i) * size;
+        for (int j = 0; j < size; ++j) row[j] *= data[i];
+    }
+    return result;
+}
+
+// Power: raise each diagonal entry
+DiagMat DiagMat::operator^(int power) const {
+    if (power < 0) throw std::invalid_argument("Negative powers not supported");
+    DiagMat result(size);
+    for (int i = 0; i < size; ++i) result.data[i] = std::pow(data[i], power);
+    return result;
+}
+
+// Transpose: a diagonal matrix is its own transpose
+DiagMat DiagMat::operator~() const {
+    return *this;
+}
+
+// Determinant: product of the diagonal
+double DiagMat::operator!() const {
+    double det = 1;
+    for (int i = 0; i < size; ++i) det *= data[i];
+    return det;
+}
@@ -0,0 +1,78 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+
+namespace mat {
+
+// BandMat: band matrix with kl sub-diagonals and ku super-diagonals.
+// Stores n*(kl+ku+1) values; every operator costs O(n * bandwidth).
+class BandMat {
+private:
+    int size;        // dimension of matrix
+    int kl;          // number of sub-diagonals
+    int ku;          // number of super-diagonals
+    double* data;    // row i holds columns i-kl .. i+ku
+
+    int width() const;                       // stored values per row
+    bool inside(int row, int col) const;     // true if (row, col) is in the band
+    double at(int row, int col) const;       // unchecked access inside the band
+    double& at(int row, int col);
+    void copy(const BandMat& other);
+
+public:
+    BandMat(int size, int kl, int ku);                   // create zero band matrix
+    BandMat(const SquareMat& mat, int kl, int ku);       // take the band of mat, drop the rest
+    BandMat(const BandMat& other);                       // copy constructor
+    BandMat& operator=(const BandMat& other);
+    ~BandMat();                                          // destructor
+
+    int dim() const;                         // matrix dimension
+    int lower() const;                       // sub-diagonal count
+    int upper() const;                       // super-diagonal count
+    double get(int row, int col) const;      // zero outside the band
+    void set(int row, int col, double value);   // throws outside the band
+    SquareMat toSquareMat() const;
+
+    BandMat operator+(const BandMat& other) const;
+    BandMat operator-(const BandMat& other) const;
+    BandMat operator-() const;
+    BandMat operator*(const BandMat& other) const;   // bandwidths add up
+    BandMat operator*(double scalar) const;
+    BandMat operator^(int power) const;
+    BandMat operator~() const;                       // swaps kl and ku
+    double operator!() const;                        // determinant via banded LU
+};
+
+// DiagMat: diagonal matrix, n values
+class DiagMat {
+private:
+    int size;        // dimension of matrix
+    double* data;    // diagonal entries
+
+    void copy(const DiagMat& other);
+
+public:
+    DiagMat(int size);                       // create zero matrix
+    DiagMat(const DiagMat& other);           // copy constructor
+    DiagMat& operator=(const DiagMat& other);
+    ~DiagMat();                              // destructor
+
+    int dim() const;                         // matrix dimension
+    double& operator[](int index);           // access diagonal entry
+    double operator[](int index) const;
+    SquareMat toSquareMat() const;
+
+    DiagMat operator+(const DiagMat& other) const;
+    DiagMat operator-(const DiagMat& other) const;
+    DiagMat operator-() const;
+    DiagMat operator*(const DiagMat& other) const;
+    DiagMat operator*(double scalar) const;
+    SquareMat operator*(const SquareMat& b) const;   // scales row i of b by d[i]
+    DiagMat operator^(int power) const;
+    DiagMat operator~() const;
+    double operator!() const;                        // product of the diagonal
+};
+
+} // namespace mat
@@ -0,0 +1,156 @@
+// avrahamavitan@gmail.com
+#include "BoolMat.hpp"
+#include "Parallel.hpp"
+
+using namespace mat;
+
+static const int ROW_GRAIN = 64; // rows per thread in products
+
+// Constructor: n x n matrix, all false
+BoolMat::BoolMat(int n) : size(n) {
+    if (n <= 0) throw std::invalid_argument("Invalid matrix size");
+    words = (n + 63) / 64;
+    bits = new uint64_t[size * words]();
+}
+
+// Build from a SquareMat: nonzero means true
+BoolMat::BoolMat(const SquareMat& mat) : BoolMat(mat.dim()) {
+    for (int i = 0; i < size; ++i) {
+        const double* row = mat[i];
+        uint64_t* out = bits + i*words;
+        for (int j = 0; j < size; ++j)
+            if (row[j] != 0) out[j / 64] |= uint64_t(1) << (j % 64);
+    }
+}
+
+// Copy bits from other matrix
+void BoolMat::copy(const BoolMat& other) {
+    size = other.size;
+    words = other.words;
+    bits = new uint64_t[size * words];
+    for (int i = 0; i < size * words; ++i) bits[i] = other.bits[i];
+}
+
+// Copy constructor
+BoolMat::BoolMat(const BoolMat& other) {
+    copy(other);
+}
+
+// Assignment operator: clean old bits and copy new ones
+BoolMat& BoolMat::operator=(const BoolMat& other) {
+    if (this != &other) {
+        delete[] bits;
+        copy(other);
+    }
+    return *this;
+}
+
+// Destructor: free memory
+BoolMat::~BoolMat() {
+    delete[] bits;
+}
+
+// Matrix dimension
+int BoolMat::dim() const {
+    return size;
+}
+
+// Read one entry
+bool BoolMat::get(int row, int col) const {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    return (bits[row*words + col / 64] >> (col % 64)) & 1;
+}
+
+// Write one entry
+void BoolMat::set(int row, int col, bool value) {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    uint64_t mask = uint64_t(1) << (col % 64);
+    if (value) bits[row*words + col / 64] |= mask;
+    else bits[row*words + col / 64] &= ~mask;
+}
+
+// Count true entries with popcount
+long long BoolMat::count() const {
+    long long total = 0;
+    for (int i = 0; i < size * words; ++i) total += __builtin_popcountll(bits[i]);
+    return total;
+}
+
+// Convert to a 0/1 SquareMat
+SquareMat BoolMat::toSquareMat() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i) {
+        double* row = out + static_cast<size_t>(i) * size;
+        for (int j = 0; j < size; ++j)
+            row[j] = (bits[i*words + j / 64] >> (j % 64)) & 1;
+    }
+    return result;
+}
+
+// Element-wise OR
+BoolMat BoolMat::operator+(const BoolMat& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    BoolMat result(size);
+    for (int i = 0; i < size * words; ++i) result.bits[i] = bits[i] | other.bits[i];
+    return result;
+}
+
+// Boolean product: row i of result is the OR of rows k of other for every set bit (i, k)
+BoolMat BoolMat::operator*(const BoolMat& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    BoolMat result(size);
+    parallelFor(0, size, ROW_GRAIN, [this, &other, &result](int lo, int hi) {
+        for (int i = lo; i < hi; ++i) {
+            uint64_t* out = result.bits + i*words;
+            const uint64_t* a = bits + i*words;
+            for (int w = 0; w < words; ++w) {
+                uint64_t word = a[w];
+                while (word) {
+                    int k = w*64 + __builtin_ctzll(word); // next set bit
+                    word &= word - 1;
+                    const uint64_t* b = other.bits + k*words;
+                    for (int x = 0; x < words; ++x) out[x] |= b[x];
+                }
+            }
+        }
+    });
+    return result;
+}
+
+// Boolean power by repeated squaring
+BoolMat BoolMat::operator^(int power) const {
+    if (power < 0) throw std::invalid_argument("Negative powers not supported");
+    BoolMat result(size);
+    for (int i = 0; i < size; ++i) result.set(i, i, true); // identity
+    BoolMat base(*this);
+    while (power) {
+        if (power % 2) result = result * base;
+        power /= 2;
+        if (power) base = base * base; // skip the last unused square
+    }
+    return result;
+}
+
+// Transitive closure: square R = R + R*R until nothing changes (at most log2(n) rounds)
+BoolMat BoolMat::closure() const {
+    BoolMat reach(*this);
+    while (true) {
+        BoolMat next = reach + reach * reach;
+        if (next == reach) return reach;
+        reach = next;
+    }
+}
+
+// Equality: every bit matches
+bool BoolMat::operator==(const BoolMat& other) const {
+    if (size != other.size) return false;
+    for (int i = 0; i < size * words; ++i)
+        if (bits[i] != other.bits[i]) return false;
+    return true;
+}
+
+// Inequality: opposite of ==
+bool BoolMat::operator!=(const BoolMat& other) const {
+    return !(*this == other);
+}
@@ -0,0 +1,42 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include <cstdint>
+
+namespace mat {
+
+// BoolMat: square boolean matrix packed 64 entries per word.
+// Products use OR/AND over whole words, for reachability on graphs.
+class BoolMat {
+private:
+    int size;            // dimension of matrix
+    int words;           // 64-bit words per row
+    uint64_t* bits;      // rows one after another, bit j%64 of word j/64
+
+    void copy(const BoolMat& other);
+
+public:
+    BoolMat(int size);                        // create all-false matrix
+    explicit BoolMat(const SquareMat& mat);   // nonzero entries become true
+    BoolMat(const BoolMat& other);            // copy constructor
+    BoolMat& operator=(const BoolMat& other);
+    ~BoolMat();                               // destructor
+
+    int dim() const;                          // matrix dimension
+    bool get(int row, int col) const;
+    void set(int row, int col, bool value);
+    long long count() const;                  // number of true entries
+    SquareMat toSquareMat() const;            // 1.0 for true, 0.0 for false
+
+    BoolMat operator+(const BoolMat& other) const;  // element-wise OR
+    BoolMat operator*(const BoolMat& other) const;  // boolean product: paths of combined length
+    BoolMat operator^(int power) const;             // paths of exactly power steps
+    BoolMat closure() const;                        // transitive closure: paths of one or more steps
+
+    bool operator==(const BoolMat& other) const;
+    bool operator!=(const BoolMat& other) const;
+};
+
+} // namespace mat
@@ -0,0 +1,177 @@
+// avrahamavitan@gmail.com
+#include "Chain.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include <cmath>
+
+namespace mat {
+
+static const double SPARSE_DENSITY = 0.25;   // right operands below this use the sparse kernel
+static const double MEMORY_WEIGHT = 4;       // cost of one value of a live intermediate, in multiply-adds
+static const int ROW_GRAIN = 16;             // output rows per thread in the sparse kernel
+
+// Structure estimate of a (partial) product
+struct Shape {
+    double nnz;       // nonzero entries
+    double rows;      // rows holding a nonzero
+    double cols;      // columns holding a nonzero
+    bool finite;      // no Inf or NaN entry
+};
+
+// Exact structure of an input matrix
+static Shape measure(const SquareMat& m) {
+    int n = m.dim();
+    Shape s = {0, 0, 0, true};
+    std::vector<bool> colUsed(n, false);
+    for (int i = 0; i < n; ++i) {
+        const double* row = m[i];
+        bool rowUsed = false;
+        for (int j = 0; j < n; ++j) {
+            if (row[j] != 0) {
+                ++s.nnz;
+                rowUsed = true;
+                colUsed[j] = true;
+            }
+            if (!std::isfinite(row[j])) s.finite = false;
+        }
+        if (rowUsed) ++s.rows;
+    }
+    for (int j = 0; j < n; ++j)
+        if (colUsed[j]) ++s.cols;
+    return s;
+}
+
+// True if l * r runs on the sparse kernel: r is sparse enough, and neither
+// side holds Inf or NaN, whose products with skipped zeros must give NaN
+static bool useSparse(const Shape& l, const Shape& r, int n) {
+    return l.finite && r.finite && r.nnz < SPARSE_DENSITY * double(n) * n;
+}
+
+// Cost of l * r in multiply-adds: the dense kernel does every term, the
+// sparse kernel visits each (l[i][k], r[k][j]) nonzero pair
+static double pairCost(const Shape& l, const Shape& r, int n) {
+    return useSparse(l, r, n) ? l.nnz * (r.nnz / n) + r.nnz : double(n) * n * n;
+}
+
+// Most intermediates alive at once while [i, j] is evaluated with the halves
+// in parallel: both halves' peaks, or their two results plus the product
+static int liveMatrices(int i, int s, int j, int leftLive, int rightLive) {
+    int results = (s > i) + (j > s + 1) + 1; // inputs are read in place (runChain), not copied
+    return leftLive + rightLive > results ? leftLive + rightLive : results;
+}
+
+// Structure of l * r: random-placement estimate, capped by the row/column bounds
+static Shape pairShape(const Shape& l, const Shape& r, int n) {
+    double nn = double(n) * n;
+    double p = (l.nnz / nn) * (r.nnz / nn); // chance one term is nonzero
+    double estimate = nn * (1 - std::pow(1 - p, n));
+    double bound = l.rows * r.cols;
+    Shape s = {estimate < bound ? estimate : bound, l.rows, r.cols, l.finite && r.finite};
+    return s;
+}
+
+// Dynamic programming over all split points; split[i][j] is the best k for
+// [i, j]. A split costs its multiply-adds plus MEMORY_WEIGHT per value of every
+// intermediate alive at the peak, so orders that hold fewer temporaries at
+// once win among equal work.
+static std::vector<std::vector<int>> planChain(const std::vector<SquareMat>& fs) {
+    int k = static_cast<int>(fs.size());
+    if (k == 0) throw std::invalid_argument("Empty product");
+    int n = fs[0].dim();
+    for (int i = 1; i < k; ++i)
+        if (fs[i].dim() != n) throw std::invalid_argument("Size mismatch");
+    double block = MEMORY_WEIGHT * double(n) * n;
+    std::vector<std::vector<double>> work(k, std::vector<double>(k, 0));
+    std::vector<std::vector<int>> live(k, std::vector<int>(k, 0));
+    std::vector<std::vector<Shape>> shape(k, std::vector<Shape>(k));
+    std::vector<std::vector<int>> split(k, std::vector<int>(k, -1));
+    for (int i = 0; i < k; ++i) shape[i][i] = measure(fs[i]);
+    for (int len = 2; len <= k; ++len)
+        for (int i = 0; i + len - 1 < k; ++i) {
+            int j = i + len - 1;
+            double best = INFINITY;
+            for (int s = i; s < j; ++s) {
+                double w = work[i][s] + work[s+1][j] + pairCost(shape[i][s], shape[s+1][j], n);
+                int m = liveMatrices(i, s, j, live[i][s], live[s+1][j]);
+                if (w + block * m < best) {
+                    best = w + block * m;
+                    work[i][j] = w;
+                    live[i][j] = m;
+                    split[i][j] = s;
+                    shape[i][j] = pairShape(shape[i][s], shape[s+1][j], n);
+                }
+            }
+        }
+    return split;
+}
+
+// l * r with r in compressed rows: only nonzero pairs are multiplied. Exact
+// for finite operands only (useSparse), where a skipped term is a true zero.
+static SquareMat sparseProduct(const SquareMat& l, const SquareMat& r) {
+    int n = l.dim();
+    std::vector<int> start(n + 1, 0);
+    std::vector<int> cols;
+    std::vector<double> vals;
+    for (int k = 0; k < n; ++k) {
+        const double* row = r[k];
+        for (int j = 0; j < n; ++j)
+            if (row[j] != 0) {
+                cols.push_back(j);
+                vals.push_back(row[j]);
+            }
+        start[k + 1] = static_cast<int>(cols.size());
+    }
+    SquareMat result(n);
+    double* out = KernelAccess::values(result); // fetched once so workers never detach
+    parallelFor(0, n, ROW_GRAIN, [&](int lo, int hi) {
+        for (int i = lo; i < hi; ++i) {
+            const double* li = l[i];
+            double* ci = out + static_cast<size_t>(i) * n;
+            for (int k = 0; k < n; ++k) {
+                double lik = li[k];
+                if (lik == 0) continue;
+                for (int p = start[k]; p < start[k + 1]; ++p) ci[cols[p]] += lik * vals[p];
+            }
+        }
+    });
+    return result;
+}
+
+// Evaluate [i, j] (i < j) with the planned splits; both halves run in
+// parallel. Single factors are read through a reference: copying an input
+// that handed out row pointers would duplicate its values.
+static SquareMat runChain(const std::vector<SquareMat>& fs, const std::vector<std::vector<int>>& split,
+                          int i, int j) {
+    int s = split[i][j];
+    SquareMat left(1), right(1); // sub-products only
+    parallelInvoke([&]() { if (s > i) left = runChain(fs, split, i, s); },
+                   [&]() { if (j > s + 1) right = runChain(fs, split, s + 1, j); });
+    const SquareMat& l = s > i ? left : fs[i];
+    const SquareMat& r = j > s + 1 ? right : fs[j];
+    int n = l.dim();
+    TraceScope product("chain product", n, i);
+    if (useSparse(measure(l), measure(r), n)) return sparseProduct(l, r);
+    return l * r;
+}
+
+// Text form of the planned order
+static std::string describe(const std::vector<std::vector<int>>& split, int i, int j) {
+    if (i == j) return std::to_string(i);
+    int s = split[i][j];
+    return "(" + describe(split, i, s) + "*" + describe(split, s + 1, j) + ")";
+}
+
+// Multiply the chain in the planned order
+SquareMat chain_multiply(const std::vector<SquareMat>& factors) {
+    std::vector<std::vector<int>> split = planChain(factors);
+    if (factors.size() == 1) return factors[0];
+    return runChain(factors, split, 0, static_cast<int>(factors.size()) - 1);
+}
+
+// Planned order as text
+std::string chain_order(const std::vector<SquareMat>& factors) {
+    std::vector<std::vector<int>> split = planChain(factors);
+    return describe(split, 0, static_cast<int>(factors.size()) - 1);
+}
+
+} // namespace mat
@@ -0,0 +1,20 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include <string>
+#include <vector>
+
+namespace mat {
+
+// Product of all factors in order, evaluated in the cheapest order found by
+// dynamic programming over a cost model: multiply-adds given each operand's
+// nonzeros (sparse right operands use a compressed-row kernel), plus the
+// intermediates alive at once. Independent sub-products run in parallel.
+SquareMat chain_multiply(const std::vector<SquareMat>& factors);
+
+// The order chain_multiply would use, e.g. "(0*(1*2))", for inspection
+std::string chain_order(const std::vector<SquareMat>& factors);
+
+} // namespace mat
@@ -0,0 +1,160 @@
+// avrahamavitan@gmail.com
+#include "Cholesky.hpp"
+#include "Parallel.hpp"
+#include <cmath>
+
+using namespace mat;
+
+static const int BLOCK = 64;       // columns per panel
+static const int ROW_GRAIN = 32;   // rows per thread in panel and trailing updates
+
+// Factor the matrix with a right-looking blocked algorithm:
+// factor a diagonal block, solve the panel below it, update the trailing matrix.
+// Only the lower triangle is read once symmetry has been checked.
+Cholesky::Cholesky(const SquareMat& mat) : size(mat.dim()) {
+    if (!mat.isNearlySymmetric()) throw std::invalid_argument("Matrix is not symmetric");
+    l.assign(static_cast<size_t>(size) * size, 0); // upper part stays zero
+    for (int i = 0; i < size; ++i) {
+        const double* row = mat[i];
+        for (int j = 0; j <= i; ++j)
+            l[static_cast<size_t>(i) * size + j] = row[j]; // lower triangle is enough
+    }
+    for (int k0 = 0; k0 < size; k0 += BLOCK) {
+        int kb = (size - k0 < BLOCK) ? size - k0 : BLOCK;
+        int k1 = k0 + kb;
+        factorBlock(k0, kb);
+        // panel: L21 = A21 * L11^-T, rows are independent
+        parallelFor(k1, size, ROW_GRAIN, [this, k0, k1](int lo, int hi) {
+            for (int i = lo; i < hi; ++i) {
+                double* ri = l.data() + static_cast<size_t>(i) * size;
+                for (int j = k0; j < k1; ++j) {
+                    const double* rj = l.data() + static_cast<size_t>(j) * size;
+                    double sum = ri[j];
+                    for (int p = k0; p < j; ++p) sum -= ri[p] * rj[p];
+                    ri[j] = sum / rj[j];
+                }
+            }
+        });
+        // trailing update: A22 -= L21 * L21^T (lower triangle only)
+        parallelFor(k1, size, ROW_GRAIN, [this, k0, k1](int lo, int hi) {
+            for (int i = lo; i < hi; ++i) {
+                double* ri = l.data() + static_cast<size_t>(i) * size;
+                for (int j = k1; j <= i; ++j) {
+                    const double* rj = l.data() + static_cast<size_t>(j) * size;
+                    double sum = 0;
+                    for (int p = k0; p < k1; ++p) sum += ri[p] * rj[p];
+                    ri[j] -= sum;
+                }
+            }
+        });
+    }
+}
+
+// Unblocked Cholesky of the kb x kb diagonal block starting at k0
+void Cholesky::factorBlock(int k0, int kb) {
+    for (int j = k0; j < k0 + kb; ++j) {
+        double* rj = l.data() + static_cast<size_t>(j) * size;
+        double d = rj[j];
+        for (int p = k0; p < j; ++p) d -= rj[p] * rj[p];
+        if (!(d > 0)) throw std::invalid_argument("Matrix is not positive definite");
+        d = std::sqrt(d);
+        rj[j] = d;
+        for (int i = j+1; i < k0 + kb; ++i) {
+            double* ri = l.data() + static_cast<size_t>(i) * size;
+            double sum = ri[j];
+            for (int p = k0; p < j; ++p) sum -= ri[p] * rj[p];
+            ri[j] = sum / d;
+        }
+    }
+}
+
+// Dimension of the factored matrix
+int Cholesky::dim() const {
+    return size;
+}
+
+// Return L as a SquareMat
+SquareMat Cholesky::factor() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j <= i; ++j)
+            out[static_cast<size_t>(i) * size + j] = l[static_cast<size_t>(i) * size + j];
+    return result;
+}
+
+// Solve L*y = b, then L^T*x = y (x may alias b)
+void Cholesky::solve(const double* b, double* x) const {
+    std::vector<double> y(size);
+    for (int i = 0; i < size; ++i) {
+        double sum = b[i];
+        const double* ri = l.data() + static_cast<size_t>(i) * size;
+        for (int j = 0; j < i; ++j) sum -= ri[j] * y[j];
+        y[i] = sum / ri[i];
+    }
+    for (int i = size-1; i >= 0; --i) {
+        double sum = y[i];
+        for (int j = i+1; j < size; ++j) sum -= l[static_cast<size_t>(j) * size + i] * y[j];
+        y[i] = sum / l[static_cast<size_t>(i) * size + i];
+    }
+    for (int i = 0; i < size; ++i) x[i] = y[i];
+}
+
+// Solve A*x = b for a Vector
+Vector Cholesky::solve(const Vector& b) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    Vector x(b);
+    solve(x.raw(), x.raw()); // in place on the copy
+    return x;
+}
+
+// Solve for every column of b at once, working on whole rows
+SquareMat Cholesky::solve(const SquareMat& b) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    SquareMat x(b);
+    double* xv = KernelAccess::values(x); // private copy of b's values
+    for (int i = 0; i < size; ++i) {
+        // forward: x_i = (b_i - sum L[i][j] x_j) / L[i][i]
+        double* xi = xv + static_cast<size_t>(i) * size;
+        const double* ri = l.data() + static_cast<size_t>(i) * size;
+        for (int j = 0; j < i; ++j) {
+            const double* xj = xv + static_cast<size_t>(j) * size;
+            for (int c = 0; c < size; ++c) xi[c] -= ri[j] * xj[c];
+        }
+        for (int c = 0; c < size; ++c) xi[c] /= ri[i];
+    }
+    for (int i = size-1; i >= 0; --i) {
+        // backward with L^T: x_i = (y_i - sum L[j][i] x_j) / L[i][i]
+        double* xi = xv + static_cast<size_t>(i) * size;
+        for (int j = i+1; j < size; ++j) {
+            double lji = l[static_cast<size_t>(j) * size + i];
+            const double* xj = xv + static_cast<size_t>(j) * size;
+            for (int c = 0; c < size; ++c) xi[c] -= lji * xj[c];
+        }
+        double d = l[static_cast<size_t>(i) * size + i];
+        for (int c = 0; c < size; ++c) xi[c] /= d;
+    }
+    return x;
+}
+
+// Inverse: solve against the identity
+SquareMat Cholesky::inverse() const {
+    SquareMat id(size);
+    double* ones = KernelAccess::values(id);
+    for (int i = 0; i < size; ++i) ones[static_cast<size_t>(i) * size + i] = 1;
+    return solve(id);
+}
+
+// Determinant: square of the product of L's diagonal
+double Cholesky::determinant() const {
+    double prod = 1;
+    for (int i = 0; i < size; ++i) prod *= l[static_cast<size_t>(i) * size + i];
+    return prod * prod;
+}
+
+// Log-determinant: 2 * sum(log L[i][i]), safe for huge and tiny determinants
+double Cholesky::logdet() const {
+    double sum = 0;
+    for (int i = 0; i < size; ++i) sum += std::log(l[static_cast<size_t>(i) * size + i]);
+    return 2 * sum;
+}
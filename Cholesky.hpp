@@ -0,0 +1,35 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include "Vector.hpp"
+#include <vector>
+
+namespace mat {
+
+// Cholesky: A = L * L^T for symmetric positive-definite A (no pivoting).
+// The constructor throws std::invalid_argument if A is not symmetric (up to
+// rounding) or not positive definite, so callers can fall back to LU.
+class Cholesky {
+private:
+    int size;                 // dimension of factored matrix
+    std::vector<double> l;    // lower triangular factor, row by row (upper part zero)
+
+    void factorBlock(int k0, int kb);   // unblocked factorization of one diagonal block
+
+public:
+    explicit Cholesky(const SquareMat& mat);  // factor the matrix once
+
+    int dim() const;                          // matrix dimension
+    SquareMat factor() const;                 // the factor L as a matrix
+
+    void solve(const double* b, double* x) const;  // solve A*x = b for one right-hand side
+    Vector solve(const Vector& b) const;           // solve A*x = b
+    SquareMat solve(const SquareMat& b) const;     // solve A*X = B, one right-hand side per column
+    SquareMat inverse() const;
+    double determinant() const;
+    double logdet() const;                    // log(det(A)), no overflow
+};
+
+} // namespace mat
@@ -0,0 +1,220 @@
+// avrahamavitan@gmail.com
+#include "DiskMat.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace mat;
+
+const int DiskMat::DEFAULT_TILE;
+
+static const size_t HEADER_BYTES = 4096;        // keeps tiles page aligned
+static const char MAGIC[8] = "SQMAT01";
+
+// File header stored in the first page
+struct DiskHeader {
+    char magic[8];
+    int size;
+    int tile;
+};
+
+// Create a new zero matrix file (sparse until written)
+DiskMat::DiskMat(const std::string& path, int size, int tile)
+    : path(path), size(size), tile(tile), fd(-1), map(nullptr) {
+    if (size <= 0) throw std::invalid_argument("Invalid matrix size");
+    if (tile <= 0) throw std::invalid_argument("Invalid tile size");
+    tiles = (size + tile - 1) / tile;
+    mapFile(true);
+}
+
+// Open an existing matrix file and read its dimensions from the header
+DiskMat::DiskMat(const std::string& path) : path(path), size(0), tile(0), tiles(0), fd(-1), map(nullptr) {
+    mapFile(false);
+}
+
+// Open (or create) the file and map it shared, so writes go back to disk
+void DiskMat::mapFile(bool create) {
+    fd = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot open matrix file: " + path);
+    DiskHeader header;
+    if (create) {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.size = size;
+        header.tile = tile;
+        size_t tileBytes = static_cast<size_t>(tile) * tile * sizeof(double);
+        bytes = HEADER_BYTES + static_cast<size_t>(tiles) * tiles * tileBytes;
+        if (ftruncate(fd, bytes) != 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+            ::close(fd);
+            throw std::runtime_error("Cannot size matrix file: " + path);
+        }
+    } else {
+        struct stat st;
+        if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+            std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Not a matrix file: " + path);
+        }
+        // a bad header would divide by zero, and a short file faults (SIGBUS) on access
+        if (header.size <= 0 || header.tile <= 0 || static_cast<size_t>(st.st_size) < HEADER_BYTES) {
+            ::close(fd);
+            throw std::runtime_error("Corrupt matrix file: " + path);
+        }
+        size = header.size;
+        tile = header.tile;
+        tiles = (size + tile - 1) / tile;
+        size_t tileValues = static_cast<size_t>(tile) * tile;
+        size_t fileValues = (st.st_size - HEADER_BYTES) / sizeof(double);
+        if (fileValues / tileValues / tiles < static_cast<size_t>(tiles)) { // divisions cannot overflow
+            ::close(fd);
+            throw std::runtime_error("Truncated matrix file: " + path);
+        }
+        bytes = st.st_size;
+    }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Cannot map matrix file: " + path);
+    }
+    map = static_cast<char*>(p);
+    values = reinterpret_cast<double*>(map + HEADER_BYTES);
+}
+
+// Destructor: unmap (dirty pages are kept by the file) and close
+DiskMat::~DiskMat() {
+    if (map) munmap(map, bytes);
+    if (fd >= 0) ::close(fd);
+}
+
+// Matrix dimension
+int DiskMat::dim() const {
+    return size;
+}
+
+// Dimension of one tile
+int DiskMat::tileSize() const {
+    return tile;
+}
+
+// Tiles per side
+int DiskMat::tileCount() const {
+    return tiles;
+}
+
+// First value of tile (ti, tj); tiles are stored row by row
+double* DiskMat::tilePtr(int ti, int tj) const {
+    return values + (static_cast<size_t>(ti) * tiles + tj) * tile * tile;
+}
+
+// Read one entry
+double DiskMat::get(int row, int col) const {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    return tilePtr(row / tile, col / tile)[(row % tile) * tile + col % tile];
+}
+
+// Write one entry
+void DiskMat::set(int row, int col, double value) {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    tilePtr(row / tile, col / tile)[(row % tile) * tile + col % tile] = value;
+}
+
+// Copy a tile into memory
+void DiskMat::loadTile(int ti, int tj, SquareMat& out) const {
+    if (ti < 0 || ti >= tiles || tj < 0 || tj >= tiles) throw std::out_of_range("Tile out of range");
+    if (out.dim() != tile) throw std::invalid_argument("Size mismatch");
+    std::memcpy(KernelAccess::values(out), tilePtr(ti, tj), static_cast<size_t>(tile) * tile * sizeof(double));
+}
+
+// Copy a tile back to the file
+void DiskMat::storeTile(int ti, int tj, const SquareMat& in) {
+    if (ti < 0 || ti >= tiles || tj < 0 || tj >= tiles) throw std::out_of_range("Tile out of range");
+    if (in.dim() != tile) throw std::invalid_argument("Size mismatch");
+    double* dst = tilePtr(ti, tj);
+    for (int i = 0; i < tile; ++i)
+        std::memcpy(dst + static_cast<size_t>(i) * tile, in[i], tile * sizeof(double));
+}
+
+// Start reading a tile in the background
+void DiskMat::prefetchTile(int ti, int tj) const {
+    if (ti < 0 || ti >= tiles || tj < 0 || tj >= tiles) return;
+    madvise(tilePtr(ti, tj), static_cast<size_t>(tile) * tile * sizeof(double), MADV_WILLNEED);
+}
+
+// Let the kernel drop a clean tile from memory first
+void DiskMat::releaseTile(int ti, int tj) const {
+    if (ti < 0 || ti >= tiles || tj < 0 || tj >= tiles) return;
+    madvise(tilePtr(ti, tj), static_cast<size_t>(tile) * tile * sizeof(double), MADV_COLD);
+}
+
+// Copy an in-memory matrix into the file
+void DiskMat::assign(const SquareMat& mat) {
+    if (mat.dim() != size) throw std::invalid_argument("Size mismatch");
+    for (int i = 0; i < size; ++i) {
+        const double* row = mat[i];
+        for (int tj = 0; tj < tiles; ++tj) {
+            int j0 = tj * tile;
+            int count = (size - j0 < tile) ? size - j0 : tile;
+            std::memcpy(tilePtr(i / tile, tj) + (i % tile) * tile, row + j0, count * sizeof(double));
+        }
+    }
+}
+
+// Read the whole matrix into memory
+SquareMat DiskMat::toSquareMat() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i) {
+        double* row = out + static_cast<size_t>(i) * size;
+        for (int tj = 0; tj < tiles; ++tj) {
+            int j0 = tj * tile;
+            int count = (size - j0 < tile) ? size - j0 : tile;
+            std::memcpy(row + j0, tilePtr(i / tile, tj) + (i % tile) * tile, count * sizeof(double));
+        }
+    }
+    return result;
+}
+
+// Write dirty pages back now
+void DiskMat::flush() {
+    if (msync(map, bytes, MS_SYNC) != 0) throw std::runtime_error("Cannot flush matrix file: " + path);
+}
+
+// Out-of-core multiply: each thread owns output tiles and keeps three tiles in
+// memory (A, B and the accumulator), prefetching the next pair while it multiplies.
+// A row of A tiles is released once every output tile of that row is stored,
+// whichever threads computed them.
+void DiskMat::multiply(const DiskMat& a, const DiskMat& b, DiskMat& c) {
+    if (a.size != b.size || a.size != c.size || a.tile != b.tile || a.tile != c.tile)
+        throw std::invalid_argument("Size mismatch");
+    if (&c == &a || &c == &b || c.path == a.path || c.path == b.path)
+        throw std::invalid_argument("Output aliases an input");
+    int tiles = a.tiles, tile = a.tile;
+    std::vector<std::atomic<int>> pending(tiles); // output tiles of each row not yet stored
+    for (int ti = 0; ti < tiles; ++ti) pending[ti].store(tiles);
+    parallelFor(0, tiles * tiles, 1, [&](int lo, int hi) {
+        SquareMat ta(tile), tb(tile), acc(tile);
+        for (int t = lo; t < hi; ++t) {
+            TraceScope product("disk tile product", tile, t);
+            int ti = t / tiles, tj = t % tiles;
+            a.prefetchTile(ti, 0);
+            b.prefetchTile(0, tj);
+            for (int k = 0; k < tiles; ++k) {
+                a.prefetchTile(ti, k + 1); // overlap the next read with this multiply
+                b.prefetchTile(k + 1, tj);
+                a.loadTile(ti, k, ta);
+                b.loadTile(k, tj, tb);
+                gemm(1.0, ta, tb, k == 0 ? 0.0 : 1.0, acc); // first product overwrites acc
+            }
+            c.storeTile(ti, tj, acc);
+            if (pending[ti].fetch_sub(1) == 1) // last tile of the row: no chunk reads this row of A again
+                for (int k = 0; k < tiles; ++k)  // (B is swept again for every row)
+                    a.releaseTile(ti, k);
+        }
+    });
+}
@@ -0,0 +1,57 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include <string>
+
+namespace mat {
+
+// DiskMat: matrix kept in a memory-mapped file as a grid of square tiles.
+// Pages are file-backed, so the kernel writes them out and evicts them under
+// memory pressure instead of the process being killed; only the tiles being
+// worked on need to be resident.
+class DiskMat {
+private:
+    std::string path;    // backing file
+    int size;            // dimension of matrix
+    int tile;            // dimension of each tile
+    int tiles;           // tiles per side
+    int fd;              // open file descriptor
+    size_t bytes;        // mapped length (header + tiles)
+    char* map;           // start of the mapping
+    double* values;      // first tile, after the header
+
+    void mapFile(bool create);
+    double* tilePtr(int ti, int tj) const;
+
+public:
+    static const int DEFAULT_TILE = 512;   // 2 MB per tile
+
+    DiskMat(const std::string& path, int size, int tile = DEFAULT_TILE);  // create zero matrix file
+    explicit DiskMat(const std::string& path);                            // open existing file
+    DiskMat(const DiskMat&) = delete;                                     // owns a mapping
+    DiskMat& operator=(const DiskMat&) = delete;
+    ~DiskMat();                                                           // unmap and close
+
+    int dim() const;                     // matrix dimension
+    int tileSize() const;                // dimension of one tile
+    int tileCount() const;               // tiles per side
+
+    double get(int row, int col) const;
+    void set(int row, int col, double value);
+    void loadTile(int ti, int tj, SquareMat& out) const;   // copy a tile into a tile-sized SquareMat
+    void storeTile(int ti, int tj, const SquareMat& in);   // copy a tile-sized SquareMat into a tile
+    void prefetchTile(int ti, int tj) const;               // ask the kernel to start reading a tile
+    void releaseTile(int ti, int tj) const;                // tell the kernel a tile is not needed soon
+
+    void assign(const SquareMat& mat);   // copy an in-memory matrix of the same size
+    SquareMat toSquareMat() const;       // only for matrices that fit in memory
+    void flush();                        // write dirty pages to the file
+
+    // c = a * b, output tiles spread across threads, each streaming its row of A
+    // and column of B with prefetch; c must be a different file
+    static void multiply(const DiskMat& a, const DiskMat& b, DiskMat& c);
+};
+
+} // namespace mat
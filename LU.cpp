@@ -0,0 +1,159 @@
+// avrahamavitan@gmail.com
+#include "LU.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace mat;
+
+// Factor the matrix: Gaussian elimination with partial (row) pivoting.
+// A pivot no larger than n * eps * max|a_ij| is treated as zero: the matrix
+// is singular to working precision and solves would return noise.
+LU::LU(const SquareMat& mat)
+    : size(mat.dim()), lu(static_cast<size_t>(size) * size), perm(size), pivotSign(1), singular(false) {
+    double largest = 0;
+    for (int i = 0; i < size; ++i) {
+        const double* row = mat[i];
+        for (int j = 0; j < size; ++j) {
+            lu[static_cast<size_t>(i) * size + j] = row[j]; // copy values row by row
+            largest = std::max(largest, std::fabs(row[j]));
+        }
+        perm[i] = i;
+    }
+    double tolerance = size * std::numeric_limits<double>::epsilon() * largest;
+    for (int k = 0; k < size; ++k) {
+        // pick the largest pivot in column k
+        int p = k;
+        for (int i = k+1; i < size; ++i)
+            if (std::fabs(lu[static_cast<size_t>(i) * size + k]) > std::fabs(lu[static_cast<size_t>(p) * size + k])) p = i;
+        if (p != k) {
+            for (int j = 0; j < size; ++j) {
+                double tmp = lu[static_cast<size_t>(k) * size + j];
+                lu[static_cast<size_t>(k) * size + j] = lu[static_cast<size_t>(p) * size + j];
+                lu[static_cast<size_t>(p) * size + j] = tmp;
+            }
+            int t = perm[k]; perm[k] = perm[p]; perm[p] = t;
+            pivotSign = -pivotSign;
+        }
+        double pivot = lu[static_cast<size_t>(k) * size + k];
+        if (std::fabs(pivot) <= tolerance) singular = true;
+        if (pivot == 0) continue; // column already eliminated, keep going
+        // eliminate below the pivot, storing the multipliers in L
+        for (int i = k+1; i < size; ++i) {
+            double* rowI = lu.data() + static_cast<size_t>(i) * size;
+            const double* rowK = lu.data() + static_cast<size_t>(k) * size;
+            double factor = rowI[k] / pivot;
+            rowI[k] = factor;
+            for (int j = k+1; j < size; ++j)
+                rowI[j] -= factor * rowK[j];
+        }
+    }
+}
+
+// Dimension of the factored matrix
+int LU::dim() const {
+    return size;
+}
+
+// True if the factored matrix is singular
+bool LU::isSingular() const {
+    return singular;
+}
+
+// Forward and back substitution for one right-hand side (x may alias b)
+void LU::solve(const double* b, double* x) const {
+    if (singular) throw std::runtime_error("Matrix is singular");
+    std::vector<double> y(size);
+    for (int i = 0; i < size; ++i) {
+        // L*y = P*b
+        double sum = b[perm[i]];
+        const double* row = lu.data() + static_cast<size_t>(i) * size;
+        for (int j = 0; j < i; ++j) sum -= row[j] * y[j];
+        y[i] = sum;
+    }
+    for (int i = size-1; i >= 0; --i) {
+        // U*x = y
+        double sum = y[i];
+        const double* row = lu.data() + static_cast<size_t>(i) * size;
+        for (int j = i+1; j < size; ++j) sum -= row[j] * y[j];
+        y[i] = sum / row[i];
+    }
+    for (int i = 0; i < size; ++i) x[i] = y[i];
+}
+
+// Solve A*x = b for a Vector
+Vector LU::solve(const Vector& b) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    Vector x(b);
+    solve(x.raw(), x.raw()); // in place on the copy
+    return x;
+}
+
+// Solve for every column of b at once
+SquareMat LU::solve(const SquareMat& b) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    if (singular) throw std::runtime_error("Matrix is singular");
+    SquareMat x(size);
+    double* xv = KernelAccess::values(x);
+    for (int i = 0; i < size; ++i) {
+        // row i of x = row perm[i] of b, then forward substitution on whole rows
+        const double* src = b[perm[i]];
+        double* xi = xv + static_cast<size_t>(i) * size;
+        for (int c = 0; c < size; ++c) xi[c] = src[c];
+        for (int j = 0; j < i; ++j) {
+            double l = lu[static_cast<size_t>(i) * size + j]; // zeros not skipped: 0 * Inf and 0 * NaN give NaN
+            const double* xj = xv + static_cast<size_t>(j) * size;
+            for (int c = 0; c < size; ++c) xi[c] -= l * xj[c];
+        }
+    }
+    for (int i = size-1; i >= 0; --i) {
+        // back substitution on whole rows
+        double* xi = xv + static_cast<size_t>(i) * size;
+        for (int j = i+1; j < size; ++j) {
+            double u = lu[static_cast<size_t>(i) * size + j];
+            const double* xj = xv + static_cast<size_t>(j) * size;
+            for (int c = 0; c < size; ++c) xi[c] -= u * xj[c];
+        }
+        double d = lu[static_cast<size_t>(i) * size + i];
+        for (int c = 0; c < size; ++c) xi[c] /= d;
+    }
+    return x;
+}
+
+// Inverse: solve against the identity
+SquareMat LU::inverse() const {
+    SquareMat id(size);
+    double* ones = KernelAccess::values(id);
+    for (int i = 0; i < size; ++i) ones[static_cast<size_t>(i) * size + i] = 1;
+    return solve(id);
+}
+
+// Determinant: product of the pivots times the swap parity
+double LU::determinant() const {
+    double det = pivotSign;
+    for (int i = 0; i < size; ++i) det *= lu[static_cast<size_t>(i) * size + i];
+    return det;
+}
+
+// Log-determinant: NaN for a negative determinant, like log(det) would give
+double LU::logdet() const {
+    int sign;
+    double logAbs = slogdet(sign);
+    return sign < 0 ? std::nan("") : logAbs;
+}
+
+// Sign and log of |det|: sum of log|pivot| never overflows or underflows
+double LU::slogdet(int& sign) const {
+    sign = pivotSign;
+    double sum = 0;
+    for (int i = 0; i < size; ++i) {
+        double pivot = lu[static_cast<size_t>(i) * size + i];
+        if (pivot == 0) {
+            sign = 0;
+            return -INFINITY;
+        }
+        if (pivot < 0) sign = -sign;
+        sum += std::log(std::fabs(pivot));
+    }
+    return sum;
+}
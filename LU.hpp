@@ -0,0 +1,35 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include "Vector.hpp"
+#include <vector>
+
+namespace mat {
+
+// LU: factorization P*A = L*U with partial pivoting, reused by every query
+class LU {
+private:
+    int size;                 // dimension of factored matrix
+    std::vector<double> lu;   // L (unit lower, below diagonal) and U packed row by row
+    std::vector<int> perm;    // perm[i] = original row stored at row i
+    int pivotSign;            // +1 or -1, parity of the row swaps
+    bool singular;            // true if a pivot was zero to working precision
+
+public:
+    explicit LU(const SquareMat& mat);    // factor the matrix once
+
+    int dim() const;                      // matrix dimension
+    bool isSingular() const;
+
+    void solve(const double* b, double* x) const;  // solve A*x = b for one right-hand side
+    Vector solve(const Vector& b) const;           // solve A*x = b
+    SquareMat solve(const SquareMat& b) const;     // solve A*X = B, one right-hand side per column
+    SquareMat inverse() const;
+    double determinant() const;
+    double logdet() const;                // log(det), NaN if det < 0, -inf if singular
+    double slogdet(int& sign) const;      // log|det|, sign set to -1, 0 or +1
+};
+
+} // namespace mat
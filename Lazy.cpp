@@ -0,0 +1,284 @@
+// avrahamavitan@gmail.com
+#include "Lazy.hpp"
+#include "Parallel.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace mat {
+
+// Node kinds
+enum LazyOp { LEAF, ADD, SUB, NEG, MUL, SCALE, POW, TRANSPOSE };
+
+// One DAG node; value is filled in once by eval
+struct LazyNode {
+    int op;
+    int left, right;        // operand nodes, -1 if unused
+    double scalar;          // SCALE factor
+    int power;              // POW exponent
+    SquareMat value;        // leaf input or cached result (placeholder until done)
+    std::atomic<bool> done; // value holds the result
+    std::mutex lock;        // held while computing value
+
+    LazyNode(int op, int left, int right, double scalar, int power, const SquareMat& value)
+        : op(op), left(left), right(right), scalar(scalar), power(power), value(value), done(op == LEAF) {}
+};
+
+// Node identity; the SCALE factor enters by its bit pattern, since a NaN would
+// compare unequal to itself and break both the merge and the map's ordering
+typedef std::tuple<int, int, int, uint64_t, int> LazyKey;
+
+// Bits of a scalar, for LazyKey
+static uint64_t scalarBits(double scalar) {
+    uint64_t bits;
+    std::memcpy(&bits, &scalar, sizeof(bits));
+    return bits;
+}
+
+// All nodes of one context, plus the table used to merge identical nodes
+struct LazyGraph {
+    std::vector<std::unique_ptr<LazyNode>> nodes;
+    std::map<LazyKey, int> index;
+    std::mutex lock;        // guards nodes and index while recording
+};
+
+// One factor of a product chain: a node, possibly used transposed
+struct Factor {
+    int id;
+    bool trans;
+};
+
+// Evaluation of one root: use counts decide what may be folded away
+class Evaluator {
+private:
+    std::vector<LazyNode*> nodes; // snapshot taken under the graph lock
+    std::vector<int> uses;        // parents of each node below the root
+
+    LazyNode& node(int id) { return *nodes[id]; }
+
+    // A node folded into its only parent is never materialized
+    bool foldable(int id) { return uses[id] == 1 && !node(id).done; }
+
+    // Count parents over the nodes reachable from root
+    void countUses(int root) {
+        std::vector<bool> seen(nodes.size(), false);
+        std::vector<int> stack(1, root);
+        seen[root] = true;
+        while (!stack.empty()) {
+            int id = stack.back();
+            stack.pop_back();
+            LazyNode& nd = node(id);
+            if (nd.done) continue; // cached: children not needed
+            int kids[2] = {nd.left, nd.right};
+            for (int k = 0; k < 2; ++k) {
+                if (kids[k] < 0) continue;
+                ++uses[kids[k]];
+                if (!seen[kids[k]]) {
+                    seen[kids[k]] = true;
+                    stack.push_back(kids[k]);
+                }
+            }
+        }
+    }
+
+    // Factors of a product, looking through single-use products and transposes
+    void flatten(Factor f, std::vector<Factor>& out) {
+        LazyNode& nd = node(f.id);
+        if (nd.op == TRANSPOSE && foldable(f.id)) {
+            flatten(Factor{nd.left, !f.trans}, out); // ~x used once: fold into the product
+        } else if (nd.op == MUL && foldable(f.id)) {
+            if (!f.trans) {
+                flatten(Factor{nd.left, false}, out);
+                flatten(Factor{nd.right, false}, out);
+            } else {
+                flatten(Factor{nd.right, true}, out); // ~(x*y) = ~y * ~x
+                flatten(Factor{nd.left, true}, out);
+            }
+        } else {
+            out.push_back(f);
+        }
+    }
+
+    // Product of factors [lo, hi): balanced halves run in parallel, and the
+    // last two-factor products pass transposes to gemm as flags
+    SquareMat chain(const std::vector<Factor>& fs, int lo, int hi) {
+        if (hi - lo == 1) {
+            SquareMat v = value(fs[lo].id);
+            return fs[lo].trans ? ~v : v;
+        }
+        SquareMat left(1), right(1);
+        bool tl = false, tr = false;
+        if (hi - lo == 2) {
+            left = value(fs[lo].id);
+            right = value(fs[lo + 1].id);
+            tl = fs[lo].trans;
+            tr = fs[lo + 1].trans;
+        } else {
+            int mid = (lo + hi) / 2;
+            parallelInvoke([&]() { left = chain(fs, lo, mid); },
+                           [&]() { right = chain(fs, mid, hi); });
+        }
+        SquareMat result(left.dim());
+        gemm(1.0, left, right, 0.0, result, tl, tr);
+        return result;
+    }
+
+    // Values of both operands, computed in parallel when neither is cached
+    void operands(LazyNode& nd, SquareMat& l, SquareMat& r) {
+        if (node(nd.left).done || node(nd.right).done) {
+            l = value(nd.left);
+            r = value(nd.right);
+        } else {
+            parallelInvoke([&]() { l = value(nd.left); }, [&]() { r = value(nd.right); });
+        }
+    }
+
+    // Compute a node's value from its operands
+    SquareMat compute(int id) {
+        LazyNode& nd = node(id);
+        SquareMat l(1), r(1);
+        std::vector<Factor> fs;
+        switch (nd.op) {
+            case ADD: operands(nd, l, r); return l + r;
+            case SUB: operands(nd, l, r); return l - r;
+            case NEG: return -value(nd.left);
+            case SCALE: return value(nd.left) * nd.scalar;
+            case POW: return value(nd.left) ^ nd.power;
+            case TRANSPOSE:
+                if (node(nd.left).op == MUL && foldable(nd.left)) {
+                    flatten(Factor{nd.left, true}, fs); // product computed transposed directly
+                    return chain(fs, 0, static_cast<int>(fs.size()));
+                }
+                return ~value(nd.left);
+            case MUL:
+                flatten(Factor{nd.left, false}, fs);
+                flatten(Factor{nd.right, false}, fs);
+                return chain(fs, 0, static_cast<int>(fs.size()));
+        }
+        throw std::logic_error("Unknown lazy node");
+    }
+
+public:
+    // Nodes below root were all recorded before it and never move (each is its
+    // own allocation), so the snapshot stays valid while other threads record
+    Evaluator(LazyGraph& g, int root) {
+        {
+            std::lock_guard<std::mutex> guard(g.lock);
+            nodes.reserve(g.nodes.size());
+            for (size_t i = 0; i < g.nodes.size(); ++i) nodes.push_back(g.nodes[i].get());
+        }
+        uses.assign(nodes.size(), 0);
+        countUses(root);
+    }
+
+    // Value of a node, computed once; concurrent callers wait on the node lock
+    SquareMat value(int id) {
+        LazyNode& nd = node(id);
+        if (nd.done) return nd.value;
+        std::lock_guard<std::mutex> guard(nd.lock);
+        if (!nd.done) {
+            nd.value = compute(id);
+            nd.done = true;
+        }
+        return nd.value;
+    }
+};
+
+// ---------- Expr ----------
+
+// Handle to node id of graph
+Expr::Expr(const std::shared_ptr<LazyGraph>& graph, int id) : graph(graph), id(id) {}
+
+// Record a node, reusing an identical one if it exists
+Expr Expr::make(int op, const Expr* other, double scalar, int power) const {
+    if (other && other->graph != graph) throw std::invalid_argument("Expressions from different contexts");
+    int left = id, right = other ? other->id : -1;
+    std::lock_guard<std::mutex> guard(graph->lock);
+    if (op == TRANSPOSE && graph->nodes[left]->op == TRANSPOSE)
+        return Expr(graph, graph->nodes[left]->left); // ~~x = x
+    if ((op == POW && power == 1) || (op == SCALE && scalar == 1))
+        return *this;
+    if (op == ADD && right < left) std::swap(left, right); // a+b and b+a are one node
+    LazyKey key(op, left, right, scalarBits(scalar), power);
+    std::map<LazyKey, int>::iterator found = graph->index.find(key);
+    if (found != graph->index.end()) return Expr(graph, found->second);
+    int next = static_cast<int>(graph->nodes.size());
+    graph->nodes.push_back(std::unique_ptr<LazyNode>(new LazyNode(op, left, right, scalar, power, SquareMat(1))));
+    graph->index[key] = next;
+    return Expr(graph, next);
+}
+
+// Record a + b
+Expr Expr::operator+(const Expr& other) const {
+    return make(ADD, &other, 0, 0);
+}
+
+// Record a - b
+Expr Expr::operator-(const Expr& other) const {
+    return make(SUB, &other, 0, 0);
+}
+
+// Record -a
+Expr Expr::operator-() const {
+    return make(NEG, nullptr, 0, 0);
+}
+
+// Record a * b
+Expr Expr::operator*(const Expr& other) const {
+    return make(MUL, &other, 0, 0);
+}
+
+// Record a * scalar
+Expr Expr::operator*(double scalar) const {
+    return make(SCALE, nullptr, scalar, 0);
+}
+
+// Record a ^ power
+Expr Expr::operator^(int power) const {
+    if (power < 0) throw std::invalid_argument("Negative powers not supported");
+    return make(POW, nullptr, 0, power);
+}
+
+// Record ~a
+Expr Expr::operator~() const {
+    return make(TRANSPOSE, nullptr, 0, 0);
+}
+
+// Evaluate the DAG below this node
+SquareMat Expr::eval() const {
+    Evaluator ev(*graph, id);
+    return ev.value(id);
+}
+
+// ---------- LazyContext ----------
+
+// Empty context
+LazyContext::LazyContext() : graph(std::make_shared<LazyGraph>()) {}
+
+// Add an input; the same shared value block gives the same leaf, so copies of
+// one matrix are merged only while nothing has written through its rows. A
+// matrix filled through operator[] is leaked and copied on every call, so the
+// merge never fires for it: each call makes a new leaf. Call leaf() once per
+// such input and reuse the Expr.
+Expr LazyContext::leaf(const SquareMat& mat) {
+    std::lock_guard<std::mutex> guard(graph->lock);
+    for (size_t i = 0; i < graph->nodes.size(); ++i) {
+        LazyNode& nd = *graph->nodes[i];
+        if (nd.op == LEAF && nd.value.sharesWith(mat)) return Expr(graph, static_cast<int>(i));
+    }
+    graph->nodes.push_back(std::unique_ptr<LazyNode>(new LazyNode(LEAF, -1, -1, 0, 0, mat)));
+    return Expr(graph, static_cast<int>(graph->nodes.size()) - 1);
+}
+
+// Distinct nodes recorded so far
+int LazyContext::nodeCount() const {
+    std::lock_guard<std::mutex> guard(graph->lock);
+    return static_cast<int>(graph->nodes.size());
+}
+
+} // namespace mat
@@ -0,0 +1,52 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include <memory>
+
+namespace mat {
+
+struct LazyGraph;   // nodes of one context, defined in Lazy.cpp
+class LazyContext;
+
+// Expr: handle to a node of a lazy expression DAG. Operators only record
+// nodes; eval() computes the result. Identical subexpressions become one
+// node and are computed once.
+class Expr {
+private:
+    std::shared_ptr<LazyGraph> graph;   // context the node lives in
+    int id;                             // node index
+
+    Expr(const std::shared_ptr<LazyGraph>& graph, int id);
+    Expr make(int op, const Expr* other, double scalar, int power) const;
+    friend class LazyContext;
+
+public:
+    Expr operator+(const Expr& other) const;
+    Expr operator-(const Expr& other) const;
+    Expr operator-() const;
+    Expr operator*(const Expr& other) const;
+    Expr operator*(double scalar) const;
+    Expr operator^(int power) const;
+    Expr operator~() const;
+
+    // Evaluate: transposes are folded into the products that use them, chains
+    // of products are split in balanced halves, and independent branches run
+    // in parallel. Results stay cached in the context for later evals.
+    SquareMat eval() const;
+};
+
+// LazyContext: owns the DAG that its expressions are recorded into
+class LazyContext {
+private:
+    std::shared_ptr<LazyGraph> graph;
+
+public:
+    LazyContext();
+    Expr leaf(const SquareMat& mat);   // input matrix (a snapshot); merged with an earlier leaf only if
+                                       // both share one block, never for a matrix filled through []
+    int nodeCount() const;             // distinct nodes recorded so far
+};
+
+} // namespace mat
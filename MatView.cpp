@@ -0,0 +1,233 @@
+// avrahamavitan@gmail.com
+#include "MatView.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+
+namespace mat {
+
+// Check that a block fits inside an n x n matrix
+static void checkBlock(int n, int row, int col, int size) {
+    if (size <= 0 || row < 0 || col < 0 || row + size > n || col + size > n)
+        throw std::out_of_range("Block out of range");
+}
+
+// ---------- ConstMatView ----------
+
+// View of a whole matrix
+ConstMatView::ConstMatView(const SquareMat& mat) : base(mat[0]), size(mat.dim()), step(mat.dim()) {}
+
+// View of the size x size block at (row, col)
+ConstMatView::ConstMatView(const SquareMat& mat, int row, int col, int size)
+    : size(size), step(mat.dim()) {
+    checkBlock(mat.dim(), row, col, size);
+    base = mat[row] + col;
+}
+
+// View of raw row-major memory
+ConstMatView::ConstMatView(const double* base, int size, int stride) : base(base), size(size), step(stride) {
+    if (size <= 0 || stride < size) throw std::invalid_argument("Invalid view");
+}
+
+// Dimension of the block
+int ConstMatView::dim() const {
+    return size;
+}
+
+// Distance between rows
+int ConstMatView::stride() const {
+    return step;
+}
+
+// Access row by index
+const double* ConstMatView::operator[](int row) const {
+    if (row < 0 || row >= size) throw std::out_of_range("Row out of range");
+    return base + static_cast<long long>(row) * step;
+}
+
+// Block of this block, same stride
+ConstMatView ConstMatView::sub(int row, int col, int n) const {
+    checkBlock(size, row, col, n);
+    return ConstMatView(base + static_cast<long long>(row) * step + col, n, step);
+}
+
+// Copy the block into a new matrix
+SquareMat ConstMatView::toSquareMat() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i) {
+        double* dst = out + static_cast<size_t>(i) * size;
+        const double* src = base + static_cast<long long>(i) * step;
+        for (int j = 0; j < size; ++j) dst[j] = src[j];
+    }
+    return result;
+}
+
+// ---------- MatView ----------
+
+// View of a whole matrix
+MatView::MatView(SquareMat& mat) : base(mat[0]), size(mat.dim()), step(mat.dim()) {}
+
+// View of the size x size block at (row, col)
+MatView::MatView(SquareMat& mat, int row, int col, int size) : size(size), step(mat.dim()) {
+    checkBlock(mat.dim(), row, col, size);
+    base = mat[row] + col;
+}
+
+// View of raw row-major memory
+MatView::MatView(double* base, int size, int stride) : base(base), size(size), step(stride) {
+    if (size <= 0 || stride < size) throw std::invalid_argument("Invalid view");
+}
+
+// Dimension of the block
+int MatView::dim() const {
+    return size;
+}
+
+// Distance between rows
+int MatView::stride() const {
+    return step;
+}
+
+// Access row by index
+double* MatView::operator[](int row) const {
+    if (row < 0 || row >= size) throw std::out_of_range("Row out of range");
+    return base + static_cast<long long>(row) * step;
+}
+
+// Block of this block, same stride
+MatView MatView::sub(int row, int col, int n) const {
+    checkBlock(size, row, col, n);
+    return MatView(base + static_cast<long long>(row) * step + col, n, step);
+}
+
+// Read-only view of the same block
+MatView::operator ConstMatView() const {
+    return ConstMatView(base, size, step);
+}
+
+// Copy values from another block of the same size
+void MatView::assign(const ConstMatView& src) {
+    if (src.dim() != size) throw std::invalid_argument("Size mismatch");
+    for (int i = 0; i < size; ++i) {
+        double* dst = base + static_cast<long long>(i) * step;
+        const double* row = src[i];
+        for (int j = 0; j < size; ++j) dst[j] = row[j];
+    }
+}
+
+// Copy the block into a new matrix
+SquareMat MatView::toSquareMat() const {
+    return ConstMatView(*this).toSquareMat();
+}
+
+// ---------- operators ----------
+
+// Add two blocks
+SquareMat operator+(const ConstMatView& a, const ConstMatView& b) {
+    if (a.dim() != b.dim()) throw std::invalid_argument("Size mismatch");
+    int n = a.dim();
+    SquareMat result(n);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < n; ++i) {
+        double* dst = out + static_cast<size_t>(i) * n;
+        const double* ra = a[i];
+        const double* rb = b[i];
+        for (int j = 0; j < n; ++j) dst[j] = ra[j] + rb[j];
+    }
+    return result;
+}
+
+// Subtract two blocks
+SquareMat operator-(const ConstMatView& a, const ConstMatView& b) {
+    if (a.dim() != b.dim()) throw std::invalid_argument("Size mismatch");
+    int n = a.dim();
+    SquareMat result(n);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < n; ++i) {
+        double* dst = out + static_cast<size_t>(i) * n;
+        const double* ra = a[i];
+        const double* rb = b[i];
+        for (int j = 0; j < n; ++j) dst[j] = ra[j] - rb[j];
+    }
+    return result;
+}
+
+// Multiply two blocks
+SquareMat operator*(const ConstMatView& a, const ConstMatView& b) {
+    if (a.dim() != b.dim()) throw std::invalid_argument("Size mismatch");
+    SquareMat result(a.dim());
+    gemm(1.0, a, b, 0.0, MatView(result));
+    return result;
+}
+
+// True if two strided blocks share any value
+static bool overlaps(const ConstMatView& x, const ConstMatView& y) {
+    const double* x0 = x[0];
+    const double* y0 = y[0];
+    const double* x1 = x[x.dim() - 1] + x.dim();
+    const double* y1 = y[y.dim() - 1] + y.dim();
+    if (x1 <= y0 || y1 <= x0) return false; // address ranges are disjoint
+    if (x.stride() != y.stride()) return true; // be conservative
+    // same stride: y starts dr rows and dc columns from x; the offset splits
+    // into (dr, dc) or (dr + 1, dc - stride), so test both placements
+    long long s = x.stride();
+    long long offset = y0 - x0;
+    long long dr = offset >= 0 ? offset / s : -((-offset + s - 1) / s);
+    long long dc = offset - dr * s;
+    for (int t = 0; t < 2; ++t, ++dr, dc -= s) {
+        bool rows = dr < x.dim() && -dr < y.dim();
+        bool cols = dc < x.dim() && -dc < y.dim();
+        if (rows && cols) return true;
+    }
+    return false;
+}
+
+// C = alpha * op(A) * op(B) + beta * C, written straight into c.
+// Rows of C are split across threads; each row is built in i-k-j order so the
+// inner loop runs over contiguous rows (except when only A is not transposed
+// and B is, where row-by-row dot products are contiguous instead).
+void gemm(double alpha, const ConstMatView& a, const ConstMatView& b, double beta, const MatView& c,
+          bool transA, bool transB) {
+    int n = c.dim();
+    if (a.dim() != n || b.dim() != n) throw std::invalid_argument("Size mismatch");
+    if (overlaps(a, c) || overlaps(b, c)) throw std::invalid_argument("Output aliases an input");
+    const double* A = a[0];
+    const double* B = b[0];
+    double* C = c[0];
+    long long sa = a.stride(), sb = b.stride(), sc = c.stride();
+    parallelFor(0, n, GEMM_ROW_GRAIN, [=](int lo, int hi) {
+        TraceScope chunk("gemm rows", n, lo);
+        for (int i = lo; i < hi; ++i) {
+            double* ci = C + i * sc;
+            if (beta == 0) {
+                for (int j = 0; j < n; ++j) ci[j] = 0; // ignore old contents, even NaN
+            } else if (beta != 1) {
+                for (int j = 0; j < n; ++j) ci[j] *= beta;
+            }
+            if (alpha == 0) continue;
+            if (!transA && transB) {
+                // (A * B^T)[i][j] = row i of A . row j of B
+                const double* ai = A + i * sa;
+                for (int j = 0; j < n; ++j) {
+                    const double* bj = B + j * sb;
+                    double sum = 0;
+                    for (int k = 0; k < n; ++k) sum += ai[k] * bj[k];
+                    ci[j] += alpha * sum;
+                }
+                continue;
+            }
+            for (int k = 0; k < n; ++k) {
+                // no skip for zero entries: 0 * Inf and 0 * NaN must stay NaN
+                double aik = alpha * (transA ? A[k * sa + i] : A[i * sa + k]);
+                if (!transB) {
+                    const double* bk = B + k * sb;
+                    for (int j = 0; j < n; ++j) ci[j] += aik * bk[j];
+                } else {
+                    for (int j = 0; j < n; ++j) ci[j] += aik * B[j * sb + k];
+                }
+            }
+        }
+    });
+}
+
+} // namespace mat
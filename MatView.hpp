@@ -0,0 +1,67 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+
+namespace mat {
+
+// ConstMatView: read-only, non-owning view of a square block of values.
+// Row i starts stride values after row i-1, so a view can cover any
+// square block of a SquareMat without copying it.
+class ConstMatView {
+private:
+    const double* base;  // first value of the block
+    int size;            // dimension of the block
+    int step;            // distance between rows
+
+public:
+    ConstMatView(const SquareMat& mat);                           // whole matrix
+    ConstMatView(const SquareMat& mat, int row, int col, int size); // block at (row, col)
+    ConstMatView(const double* base, int size, int stride);       // raw memory
+
+    int dim() const;                         // dimension of the block
+    int stride() const;                      // distance between rows
+    const double* operator[](int row) const; // access row
+    ConstMatView sub(int row, int col, int size) const;   // block of this block
+    SquareMat toSquareMat() const;           // copy out
+};
+
+// MatView: writable, non-owning view of a square block of values.
+// Creating it from a SquareMat makes that matrix's values private first
+// (copy-on-write) and marks them leaked, so copies of the matrix taken while
+// the view exists are deep and never see writes through the view. The view is
+// valid while the matrix is alive and not assigned a new value.
+class MatView {
+private:
+    double* base;        // first value of the block
+    int size;            // dimension of the block
+    int step;            // distance between rows
+
+public:
+    MatView(SquareMat& mat);                                 // whole matrix
+    MatView(SquareMat& mat, int row, int col, int size);     // block at (row, col)
+    MatView(double* base, int size, int stride);             // raw memory
+
+    int dim() const;                         // dimension of the block
+    int stride() const;                      // distance between rows
+    double* operator[](int row) const;       // access row
+    MatView sub(int row, int col, int size) const;   // block of this block
+    operator ConstMatView() const;           // read-only view of the same block
+    void assign(const ConstMatView& src);    // copy values in
+    SquareMat toSquareMat() const;           // copy out
+};
+
+SquareMat operator+(const ConstMatView& a, const ConstMatView& b);
+SquareMat operator-(const ConstMatView& a, const ConstMatView& b);
+SquareMat operator*(const ConstMatView& a, const ConstMatView& b);
+
+// Output rows per parallelFor chunk in gemm. SquareMat's parallel zero fill
+// uses the same grain, so both split the rows at the same boundaries.
+static const int GEMM_ROW_GRAIN = 16;
+
+// C = alpha * op(A) * op(B) + beta * C on views; c must not overlap a or b
+void gemm(double alpha, const ConstMatView& a, const ConstMatView& b, double beta, const MatView& c,
+          bool transA = false, bool transB = false);
+
+} // namespace mat
@@ -0,0 +1,131 @@
+// avrahamavitan@gmail.com
+#include "Numa.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace mat {
+
+static const char* NODE_DIR = "/sys/devices/system/node/";
+
+// Parse a kernel list such as "0-3,8,10-11"
+static std::vector<int> parseList(const std::string& text) {
+    std::vector<int> items;
+    std::stringstream in(text);
+    std::string part;
+    while (std::getline(in, part, ',')) {
+        if (part.empty() || part == "\n") continue;
+        size_t dash = part.find('-');
+        int lo = std::atoi(part.c_str());
+        int hi = dash == std::string::npos ? lo : std::atoi(part.c_str() + dash + 1);
+        for (int i = lo; i <= hi; ++i) items.push_back(i);
+    }
+    return items;
+}
+
+// Contents of a list file, empty if it cannot be read
+static std::vector<int> readList(const std::string& path) {
+    std::ifstream file(path.c_str());
+    std::string line;
+    if (!file || !std::getline(file, line)) return std::vector<int>();
+    return parseList(line);
+}
+
+// Online nodes, read once
+std::vector<int> numaNodes() {
+    static const std::vector<int> nodes = []() {
+        std::vector<int> found = readList(std::string(NODE_DIR) + "online");
+        if (found.empty()) found.push_back(0);
+        return found;
+    }();
+    return nodes;
+}
+
+// CPUs of one node
+std::vector<int> numaNodeCpus(int node) {
+    std::ostringstream path;
+    path << NODE_DIR << "node" << node << "/cpulist";
+    return readList(path.str());
+}
+
+// Affinity mask, read once; the first call comes from a worker before it
+// pins itself, so this is the mask the process was started with
+std::vector<int> allowedCpus() {
+    static const std::vector<int> cpus = []() {
+        std::vector<int> found;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            for (int c = 0; c < CPU_SETSIZE; ++c)
+                if (CPU_ISSET(c, &set)) found.push_back(c);
+        return found;
+    }();
+    return cpus;
+}
+
+// Round-robin over nodes first, so consecutive workers land on different nodes
+int workerCpu(int index) {
+    std::vector<int> allowed = allowedCpus();
+    std::vector<std::vector<int>> usable; // allowed CPUs of each node that has some
+    std::vector<int> nodes = numaNodes();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        std::vector<int> cpus = numaNodeCpus(nodes[i]), mine;
+        for (size_t c = 0; c < cpus.size(); ++c)
+            if (std::find(allowed.begin(), allowed.end(), cpus[c]) != allowed.end()) mine.push_back(cpus[c]);
+        if (!mine.empty()) usable.push_back(mine);
+    }
+    if (usable.empty()) return allowed.empty() ? -1 : allowed[index % allowed.size()];
+    const std::vector<int>& cpus = usable[index % usable.size()];
+    return cpus[(index / usable.size()) % cpus.size()];
+}
+
+// Restrict the calling thread to one CPU
+bool pinThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Environment override, else pin only where placement matters
+bool pinningEnabled() {
+    static const bool enabled = []() {
+        const char* env = std::getenv("SQUAREMAT_PIN");
+        if (env) return std::atoi(env) != 0;
+        return numaNodes().size() > 1;
+    }();
+    return enabled;
+}
+
+// Ask the kernel where each page of the value block lives (move_pages with
+// no target nodes only reports)
+std::vector<long> pagesPerNode(const SquareMat& m) {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    int n = m.dim();
+    unsigned long first = reinterpret_cast<unsigned long>(m[0]) / pageSize;
+    unsigned long last = (reinterpret_cast<unsigned long>(m[0] + static_cast<long>(n) * n) - 1) / pageSize;
+    unsigned long count = last - first + 1;
+    std::vector<void*> pages(count);
+    std::vector<int> status(count, -1);
+    for (unsigned long p = 0; p < count; ++p)
+        pages[p] = reinterpret_cast<void*>((first + p) * pageSize);
+    if (syscall(SYS_move_pages, 0, count, &pages[0], nullptr, &status[0], 0) != 0)
+        throw std::runtime_error("Page placement is not available");
+    std::vector<long> perNode(numaNodes().back() + 1, 0);
+    for (unsigned long p = 0; p < count; ++p) {
+        int node = status[p];
+        if (node < 0) continue; // not resident yet, or not queryable
+        if (node >= static_cast<int>(perNode.size())) perNode.resize(node + 1, 0);
+        ++perNode[node];
+    }
+    return perNode;
+}
+
+} // namespace mat
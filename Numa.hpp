@@ -0,0 +1,35 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include <vector>
+
+namespace mat {
+
+// NUMA topology as the kernel reports it under /sys/devices/system/node.
+// Machines without that directory look like a single node 0.
+std::vector<int> numaNodes();            // online memory nodes
+std::vector<int> numaNodeCpus(int node); // CPUs of node (empty when unknown)
+
+// CPUs the process may run on (its affinity mask at first use)
+std::vector<int> allowedCpus();
+
+// CPU for pool worker index: workers are dealt round-robin over the nodes
+// that have allowed CPUs, then over those CPUs. Falls back to the allowed
+// CPUs when no node list matches; -1 when nothing is known.
+int workerCpu(int index);
+
+// Pin the calling thread to cpu; false if the system refused
+bool pinThread(int cpu);
+
+// Whether pool workers are pinned: SQUAREMAT_PIN=0/1, by default only on
+// machines with more than one node
+bool pinningEnabled();
+
+// Resident pages of the matrix values on each node (indexed by node id),
+// from the move_pages query. Pages not touched yet are not counted.
+// Throws runtime_error if the system cannot report placement.
+std::vector<long> pagesPerNode(const SquareMat& m);
+
+} // namespace mat
@@ -0,0 +1,323 @@
+// avrahamavitan@gmail.com
+#include "PackedMat.hpp"
+#include "Parallel.hpp"
+
+using namespace mat;
+
+static const int ROW_GRAIN = 16; // output rows per thread in products
+
+// Offset of (row, col) with row >= col in a packed lower triangle; in size_t
+// because row * (row + 1) overflows int from n = 46341
+static inline size_t packed(int row, int col) {
+    return static_cast<size_t>(row) * (row + 1) / 2 + col;
+}
+
+// ---------- SymMat ----------
+
+// Constructor: create n x n zero matrix
+SymMat::SymMat(int n) : size(n) {
+    if (n <= 0) throw std::invalid_argument("Invalid matrix size");
+    data = new double[packed(n, 0)]();
+}
+
+// Build from a symmetric SquareMat; symmetric up to rounding is enough, and
+// the lower triangle is the one kept
+SymMat::SymMat(const SquareMat& mat) : SymMat(mat.dim()) {
+    if (!mat.isNearlySymmetric()) throw std::invalid_argument("Matrix is not symmetric");
+    for (int i = 0; i < size; ++i) {
+        const double* row = mat[i];
+        for (int j = 0; j <= i; ++j) data[packed(i, j)] = row[j];
+    }
+}
+
+// Copy values from other matrix
+void SymMat::copy(const SymMat& other) {
+    size = other.size;
+    size_t count = packed(size, 0);
+    data = new double[count];
+    for (size_t i = 0; i < count; ++i) data[i] = other.data[i];
+}
+
+// Copy constructor
+SymMat::SymMat(const SymMat& other) {
+    copy(other);
+}
+
+// Assignment operator: clean old data and copy new data
+SymMat& SymMat::operator=(const SymMat& other) {
+    if (this != &other) {
+        delete[] data;
+        copy(other);
+    }
+    return *this;
+}
+
+// Destructor: free memory
+SymMat::~SymMat() {
+    delete[] data;
+}
+
+// Matrix dimension
+int SymMat::dim() const {
+    return size;
+}
+
+// Either triangle maps to the stored lower one
+size_t SymMat::index(int row, int col) const {
+    return row >= col ? packed(row, col) : packed(col, row);
+}
+
+// Read one entry
+double SymMat::get(int row, int col) const {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    return data[index(row, col)];
+}
+
+// Write one entry (and its mirror)
+void SymMat::set(int row, int col, double value) {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    data[index(row, col)] = value;
+}
+
+// Expand to a full matrix
+SquareMat SymMat::toSquareMat() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j <= i; ++j) {
+            out[static_cast<size_t>(i) * size + j] = data[packed(i, j)];
+            out[static_cast<size_t>(j) * size + i] = data[packed(i, j)];
+        }
+    return result;
+}
+
+// SYMM: row i of S is the packed row i (k <= i) followed by column i (k > i)
+SquareMat SymMat::operator*(const SquareMat& b) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    SquareMat c(size);
+    double* out = KernelAccess::values(c); // fetched once: workers never touch c itself
+    parallelFor(0, size, ROW_GRAIN, [&](int lo, int hi) {
+        for (int i = lo; i < hi; ++i) {
+            double* ci = out + static_cast<size_t>(i) * size;
+            for (int k = 0; k < size; ++k) {
+                double s = data[index(i, k)]; // zeros not skipped: 0 * Inf is NaN
+                const double* bk = b[k];
+                for (int j = 0; j < size; ++j) ci[j] += s * bk[j];
+            }
+        }
+    });
+    return c;
+}
+
+// SYMV: each stored entry is used twice, for (i, j) and (j, i)
+Vector SymMat::operator*(const Vector& x) const {
+    if (x.dim() != size) throw std::invalid_argument("Size mismatch");
+    Vector y(size);
+    const double* xv = x.raw();
+    double* yv = y.raw();
+    for (int i = 0; i < size; ++i) {
+        const double* row = data + packed(i, 0);
+        double sum = 0;
+        for (int j = 0; j < i; ++j) {
+            sum += row[j] * xv[j];
+            yv[j] += row[j] * xv[i]; // mirrored entry
+        }
+        yv[i] += sum + row[i] * xv[i];
+    }
+    return y;
+}
+
+// ---------- TriMat ----------
+
+// Constructor: create n x n zero triangular matrix
+TriMat::TriMat(int n, bool lower) : size(n), lower(lower) {
+    if (n <= 0) throw std::invalid_argument("Invalid matrix size");
+    data = new double[packed(n, 0)]();
+}
+
+// Build from one triangle of a SquareMat; the other triangle is ignored
+TriMat::TriMat(const SquareMat& mat, bool lower) : TriMat(mat.dim(), lower) {
+    for (int i = 0; i < size; ++i) {
+        const double* row = mat[i];
+        for (int j = 0; j <= i; ++j)
+            data[packed(i, j)] = lower ? row[j] : mat[j][i];
+    }
+}
+
+// Copy values from other matrix
+void TriMat::copy(const TriMat& other) {
+    size = other.size;
+    lower = other.lower;
+    size_t count = packed(size, 0);
+    data = new double[count];
+    for (size_t i = 0; i < count; ++i) data[i] = other.data[i];
+}
+
+// Copy constructor
+TriMat::TriMat(const TriMat& other) {
+    copy(other);
+}
+
+// Assignment operator: clean old data and copy new data
+TriMat& TriMat::operator=(const TriMat& other) {
+    if (this != &other) {
+        delete[] data;
+        copy(other);
+    }
+    return *this;
+}
+
+// Destructor: free memory
+TriMat::~TriMat() {
+    delete[] data;
+}
+
+// Matrix dimension
+int TriMat::dim() const {
+    return size;
+}
+
+// True for lower triangular
+bool TriMat::isLower() const {
+    return lower;
+}
+
+// Triangle membership
+bool TriMat::inside(int row, int col) const {
+    return lower ? row >= col : row <= col;
+}
+
+// Upper entries are stored as the lower entries of the transpose
+double TriMat::at(int row, int col) const {
+    return lower ? data[packed(row, col)] : data[packed(col, row)];
+}
+
+// Read one entry
+double TriMat::get(int row, int col) const {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    return inside(row, col) ? at(row, col) : 0;
+}
+
+// Write one entry inside the triangle
+void TriMat::set(int row, int col, double value) {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    if (!inside(row, col)) throw std::invalid_argument("Entry outside the triangle");
+    if (lower) data[packed(row, col)] = value;
+    else data[packed(col, row)] = value;
+}
+
+// Expand to a full matrix
+SquareMat TriMat::toSquareMat() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j <= i; ++j) {
+            if (lower) out[static_cast<size_t>(i) * size + j] = data[packed(i, j)];
+            else out[static_cast<size_t>(j) * size + i] = data[packed(i, j)];
+        }
+    return result;
+}
+
+// Transpose: the packed values are already in the right order
+TriMat TriMat::transpose() const {
+    TriMat result(*this);
+    result.lower = !lower;
+    return result;
+}
+
+// Determinant of a triangular matrix
+double TriMat::determinant() const {
+    double det = 1;
+    for (int i = 0; i < size; ++i) det *= data[packed(i, i)];
+    return det;
+}
+
+// TRMM: only the k inside the triangle contribute to row i
+SquareMat TriMat::operator*(const SquareMat& b) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    SquareMat c(size);
+    double* out = KernelAccess::values(c); // fetched once: workers never touch c itself
+    parallelFor(0, size, ROW_GRAIN, [&](int lo, int hi) {
+        for (int i = lo; i < hi; ++i) {
+            double* ci = out + static_cast<size_t>(i) * size;
+            int k0 = lower ? 0 : i;
+            int k1 = lower ? i + 1 : size;
+            for (int k = k0; k < k1; ++k) {
+                double t = at(i, k); // zeros not skipped: 0 * Inf is NaN
+                const double* bk = b[k];
+                for (int j = 0; j < size; ++j) ci[j] += t * bk[j];
+            }
+        }
+    });
+    return c;
+}
+
+// TRMV: half the multiply-adds of a full product
+Vector TriMat::operator*(const Vector& x) const {
+    if (x.dim() != size) throw std::invalid_argument("Size mismatch");
+    Vector y(size);
+    const double* xv = x.raw();
+    double* yv = y.raw();
+    for (int i = 0; i < size; ++i) {
+        int k0 = lower ? 0 : i;
+        int k1 = lower ? i + 1 : size;
+        double sum = 0;
+        for (int k = k0; k < k1; ++k) sum += at(i, k) * xv[k];
+        yv[i] = sum;
+    }
+    return y;
+}
+
+// Substitution in place on count right-hand sides stored as rows of x:
+// forward when the effective matrix is lower, backward when upper
+void TriMat::substitute(bool transposed, double** x, int count) const {
+    int n = size;
+    bool effLower = lower != transposed;
+    for (int step = 0; step < n; ++step) {
+        int i = effLower ? step : n - 1 - step;
+        double d = at(i, i);
+        if (d == 0) throw std::runtime_error("Matrix is singular");
+        int j0 = effLower ? 0 : i + 1;
+        int j1 = effLower ? i : n;
+        double* xi = x[i];
+        for (int j = j0; j < j1; ++j) {
+            double tij = transposed ? at(j, i) : at(i, j); // zeros not skipped: 0 * Inf is NaN
+            const double* xj = x[j];
+            for (int c = 0; c < count; ++c) xi[c] -= tij * xj[c];
+        }
+        for (int c = 0; c < count; ++c) xi[c] /= d;
+    }
+}
+
+// Solve T * x = b (or T^T * x = b)
+Vector TriMat::solve(const Vector& b, bool transposed) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    Vector x(b);
+    double** rows = new double*[size];
+    for (int i = 0; i < size; ++i) rows[i] = x.raw() + i; // one value per "row"
+    try {
+        substitute(transposed, rows, 1);
+    } catch (...) {
+        delete[] rows;
+        throw;
+    }
+    delete[] rows;
+    return x;
+}
+
+// TRSM: solve T * X = B for every column of B, working on whole rows
+SquareMat TriMat::solve(const SquareMat& b, bool transposed) const {
+    if (b.dim() != size) throw std::invalid_argument("Size mismatch");
+    SquareMat x(b);
+    double* xv = KernelAccess::values(x); // private copy of b's values
+    double** rows = new double*[size];
+    for (int i = 0; i < size; ++i) rows[i] = xv + static_cast<size_t>(i) * size;
+    try {
+        substitute(transposed, rows, size);
+    } catch (...) {
+        delete[] rows;
+        throw;
+    }
+    delete[] rows;
+    return x;
+}
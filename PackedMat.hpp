@@ -0,0 +1,72 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include "Vector.hpp"
+
+namespace mat {
+
+// SymMat: symmetric matrix storing only the lower triangle, n*(n+1)/2 values
+class SymMat {
+private:
+    int size;        // dimension of matrix
+    double* data;    // packed lower triangle, row by row
+
+    size_t index(int row, int col) const;   // packed position of (row, col), either triangle
+    void copy(const SymMat& other);
+
+public:
+    SymMat(int size);                        // create zero matrix
+    explicit SymMat(const SquareMat& mat);   // throws if mat is not symmetric
+    SymMat(const SymMat& other);             // copy constructor
+    SymMat& operator=(const SymMat& other);
+    ~SymMat();                               // destructor
+
+    int dim() const;                         // matrix dimension
+    double get(int row, int col) const;
+    void set(int row, int col, double value);   // sets (row, col) and (col, row)
+    SquareMat toSquareMat() const;
+
+    SquareMat operator*(const SquareMat& b) const;   // SYMM: S * B
+    Vector operator*(const Vector& x) const;         // SYMV: S * x
+};
+
+// TriMat: lower or upper triangular matrix storing n*(n+1)/2 values.
+// Both kinds share one packed layout, so transpose() only flips the kind.
+class TriMat {
+private:
+    int size;        // dimension of matrix
+    bool lower;      // true for lower triangular, false for upper
+    double* data;    // lower: rows of the lower part; upper: columns of the upper part
+
+    bool inside(int row, int col) const;        // true if (row, col) is in the triangle
+    double at(int row, int col) const;          // unchecked access inside the triangle
+    void substitute(bool transposed, double** x, int count) const; // in-place solve on rows of x
+    void copy(const TriMat& other);
+
+public:
+    TriMat(int size, bool lower = true);        // create zero matrix
+    TriMat(const SquareMat& mat, bool lower);   // take one triangle of mat
+    TriMat(const TriMat& other);                // copy constructor
+    TriMat& operator=(const TriMat& other);
+    ~TriMat();                                  // destructor
+
+    int dim() const;                            // matrix dimension
+    bool isLower() const;
+    double get(int row, int col) const;         // zero outside the triangle
+    void set(int row, int col, double value);   // throws outside the triangle
+    SquareMat toSquareMat() const;
+
+    TriMat transpose() const;                   // same storage, other kind
+    double determinant() const;                 // product of the diagonal
+
+    SquareMat operator*(const SquareMat& b) const;   // TRMM: T * B
+    Vector operator*(const Vector& x) const;         // TRMV: T * x
+
+    // Triangular solves; with transposed set, solve T^T * x = b without forming T^T
+    Vector solve(const Vector& b, bool transposed = false) const;
+    SquareMat solve(const SquareMat& b, bool transposed = false) const;   // TRSM, per column
+};
+
+} // namespace mat
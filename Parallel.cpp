@@ -0,0 +1,351 @@
+// avrahamavitan@gmail.com
+#include "Parallel.hpp"
+#include "Numa.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <random>
+
+namespace mat {
+
+// Hardware threads (or SQUAREMAT_THREADS), at least one
+int threadCount() {
+    static const int count = []() {
+        const char* env = std::getenv("SQUAREMAT_THREADS");
+        int n = env ? std::atoi(env) : static_cast<int>(std::thread::hardware_concurrency());
+        return n > 0 ? n : 1;
+    }();
+    return count;
+}
+
+// ---------- ThreadPool ----------
+
+// Deque and counters of one worker. The owner pushes and pops at the back,
+// thieves take from the front, so a steal gets the oldest (largest) task.
+struct ThreadPool::Worker {
+    std::deque<std::function<void()>> tasks;
+    std::mutex lock;
+    std::atomic<long long> executed, stolen, spawned, sleeps;
+
+    Worker() : executed(0), stolen(0), spawned(0), sleeps(0) {}
+};
+
+// Pool and worker index of the calling thread (-1 outside any pool)
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local int currentIndex = -1;
+
+// Victim choice for steals, one generator per thread
+static std::minstd_rand& stealRandom() {
+    static thread_local std::minstd_rand random(
+        static_cast<unsigned>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+    return random;
+}
+
+// Shared pool, created on first use
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(threadCount());
+    return pool;
+}
+
+// Start the workers
+ThreadPool::ThreadPool(int threads) : pending(0), stopping(false) {
+    if (threads <= 0) throw std::invalid_argument("Invalid thread count");
+    for (int i = 0; i < threads; ++i) deques.push_back(std::unique_ptr<Worker>(new Worker()));
+    for (int i = 0; i < threads; ++i)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+// Let the workers drain the queues, then join them
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+}
+
+// Number of workers
+int ThreadPool::size() const {
+    return static_cast<int>(workers.size());
+}
+
+// Queue a task: on the caller's own deque if it is one of our workers,
+// otherwise on the shared queue; then wake a sleeping worker
+void ThreadPool::post(std::function<void()> task) {
+    int self = currentPool == this ? currentIndex : -1;
+    if (self >= 0) {
+        Worker& own = *deques[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.tasks.push_back(std::move(task));
+        own.spawned.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    if (self < 0) injected.push_back(std::move(task));
+    ++pending;
+    wake.notify_one();
+}
+
+// Find a task for worker self (-1 for other threads): newest of its own
+// deque, else oldest of the shared queue, else oldest of a random victim
+bool ThreadPool::take(int self, std::function<void()>& task) {
+    bool found = false, stolen = false;
+    if (self >= 0) {
+        Worker& own = *deques[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    if (!found) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!injected.empty()) {
+            task = std::move(injected.front());
+            injected.pop_front();
+            found = true;
+        }
+    }
+    int n = static_cast<int>(deques.size());
+    int start = static_cast<int>(stealRandom()() % n);
+    for (int i = 0; i < n && !found; ++i) {
+        int victim = (start + i) % n;
+        if (victim == self) continue;
+        Worker& other = *deques[victim];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            found = stolen = true;
+        }
+    }
+    if (!found) return false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        --pending;
+    }
+    if (self >= 0) {
+        deques[self]->executed.fetch_add(1, std::memory_order_relaxed);
+        if (stolen) deques[self]->stolen.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// Worker: run tasks until the pool stops and every queue is empty
+void ThreadPool::workerLoop(int index) {
+    currentPool = this;
+    currentIndex = index;
+    if (pinningEnabled()) pinThread(workerCpu(index)); // keep first-touched pages local
+    while (true) {
+        std::function<void()> task;
+        if (take(index, task)) {
+            task(); // tasks report their own errors (packaged_task, TaskGroup, parallelFor)
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(lock);
+        if (pending > 0) continue; // a task arrived meanwhile
+        if (stopping) return;
+        deques[index]->sleeps.fetch_add(1, std::memory_order_relaxed);
+        wake.wait(guard, [this]() { return stopping || pending > 0; });
+    }
+}
+
+// Counters of every worker
+std::vector<WorkerStats> ThreadPool::stats() const {
+    std::vector<WorkerStats> result;
+    for (size_t i = 0; i < deques.size(); ++i) {
+        const Worker& w = *deques[i];
+        WorkerStats s = {w.executed.load(), w.stolen.load(), w.spawned.load(), w.sleeps.load()};
+        result.push_back(s);
+    }
+    return result;
+}
+
+// Zero every counter
+void ThreadPool::resetStats() {
+    for (size_t i = 0; i < deques.size(); ++i) {
+        Worker& w = *deques[i];
+        w.executed = 0;
+        w.stolen = 0;
+        w.spawned = 0;
+        w.sleeps = 0;
+    }
+}
+
+// ---------- TaskGroup ----------
+
+// Tasks of one group. Runners posted to the pool hold a reference, so a
+// runner that starts after the group is gone finds an empty queue.
+struct TaskGroup::State {
+    std::deque<std::function<void()>> tasks;   // not started yet
+    int pending;                                // spawned tasks not finished yet
+    std::exception_ptr error;                   // first failure
+    std::mutex lock;
+    std::condition_variable finished;
+
+    State() : pending(0) {}
+};
+
+// Run one not-yet-started task of the group: the oldest for pool runners
+// (like a steal), the newest for the waiting owner. False if none is left.
+bool TaskGroup::runOne(State& s, bool oldest) {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> guard(s.lock);
+        if (s.tasks.empty()) return false;
+        if (oldest) {
+            task = std::move(s.tasks.front());
+            s.tasks.pop_front();
+        } else {
+            task = std::move(s.tasks.back());
+            s.tasks.pop_back();
+        }
+    }
+    std::exception_ptr failure;
+    try {
+        task();
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (failure && !s.error) s.error = failure;
+    if (--s.pending == 0) s.finished.notify_all();
+    return true;
+}
+
+// Empty group
+TaskGroup::TaskGroup() : state(std::make_shared<State>()) {}
+
+// Never leave tasks that point at a destroyed group's data
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+        // the owner did not wait, so nobody is asking for the error
+    }
+}
+
+// Keep the task, under the spawner's allocation site, and post one runner for it
+void TaskGroup::spawn(std::function<void()> task) {
+    const char* site = allocSite();
+    std::function<void()> charged = [site, task]() {
+        AllocSite scope(site); // not the runner's or the waiter's site
+        task();
+    };
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->tasks.push_back(std::move(charged));
+        ++state->pending;
+    }
+    std::shared_ptr<State> shared = state;
+    ThreadPool::instance().post([shared]() { runOne(*shared, true); });
+}
+
+// Run our own tasks until none is left unstarted, then wait for the ones
+// runners are still executing
+void TaskGroup::wait() {
+    while (runOne(*state, false)) {}
+    std::unique_lock<std::mutex> guard(state->lock);
+    state->finished.wait(guard, [this]() { return state->pending == 0; });
+    std::exception_ptr failure = state->error;
+    state->error = nullptr;
+    guard.unlock();
+    if (failure) std::rethrow_exception(failure);
+}
+
+// ---------- parallelFor ----------
+
+// True on threads that are already running a parallelFor chunk
+static thread_local bool inParallel = false;
+
+// Shared by the caller and the helper tasks of one parallelFor
+struct LoopState {
+    const std::function<void(int, int)>* body;
+    const char* site;             // allocation site of the caller
+    int begin, n, chunks;
+    std::atomic<int> next;        // next chunk to claim
+    std::atomic<int> done;        // chunks finished
+    std::exception_ptr error;     // first failure
+    std::mutex lock;
+    std::condition_variable finished;
+};
+
+// Claim and run chunks until none are left. A helper that starts after the
+// loop is over finds nothing to claim and never touches body.
+static void runChunks(LoopState& s) {
+    bool outer = inParallel;
+    inParallel = true;
+    AllocSite site(s.site);
+    int c;
+    while ((c = s.next.fetch_add(1)) < s.chunks) {
+        int lo = s.begin + static_cast<long long>(s.n) * c / s.chunks;
+        int hi = s.begin + static_cast<long long>(s.n) * (c + 1) / s.chunks;
+        try {
+            (*s.body)(lo, hi);
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(s.lock);
+            if (!s.error) s.error = std::current_exception();
+        }
+        if (s.done.fetch_add(1) + 1 == s.chunks) {
+            std::lock_guard<std::mutex> guard(s.lock);
+            s.finished.notify_all();
+        }
+    }
+    inParallel = outer;
+}
+
+// Post helpers to the pool and work alongside them; the caller only waits for
+// chunks a helper has already started, so a busy pool cannot deadlock it
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body) {
+    int n = end - begin;
+    if (n <= 0) return;
+    if (grain < 1) grain = 1;
+    int chunks = n / grain;
+    if (chunks > threadCount()) chunks = threadCount();
+    if (chunks <= 1 || inParallel) {
+        body(begin, end); // not worth a thread, or already parallel
+        return;
+    }
+    std::shared_ptr<LoopState> state = std::make_shared<LoopState>();
+    state->body = &body;
+    state->site = allocSite();
+    state->begin = begin;
+    state->n = n;
+    state->chunks = chunks;
+    state->next = 0;
+    state->done = 0;
+    ThreadPool& pool = ThreadPool::instance();
+    for (int c = 1; c < chunks; ++c)
+        pool.post([state]() { runChunks(*state); });
+    runChunks(*state);
+    {
+        std::unique_lock<std::mutex> guard(state->lock);
+        state->finished.wait(guard, [&state]() { return state->done.load() == state->chunks; });
+    }
+    if (state->error) std::rethrow_exception(state->error); // report the first failure
+}
+
+// ---------- parallelInvoke ----------
+
+// Fork-join of two tasks on a TaskGroup: first is queued, second runs here,
+// and the wait runs first itself if no worker has stolen it
+void parallelInvoke(const std::function<void()>& first, const std::function<void()>& second) {
+    if (threadCount() == 1) {
+        first();
+        second();
+        return;
+    }
+    TaskGroup group;
+    group.spawn(first);
+    std::exception_ptr secondError;
+    try {
+        second();
+    } catch (...) {
+        secondError = std::current_exception();
+    }
+    group.wait(); // rethrows a failure of first
+    if (secondError) std::rethrow_exception(secondError);
+}
+
+} // namespace mat
@@ -0,0 +1,107 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "Alloc.hpp"
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace mat {
+
+int threadCount();   // threads used by parallel kernels (SQUAREMAT_THREADS overrides the core count)
+
+// Counters of one pool worker, read with ThreadPool::stats()
+struct WorkerStats {
+    long long executed;   // tasks run
+    long long stolen;     // of those, taken from another worker's deque
+    long long spawned;    // tasks pushed onto its own deque
+    long long sleeps;     // times it found no work anywhere and slept
+};
+
+// ThreadPool: work-stealing pool. Each worker owns a deque: tasks posted from a
+// worker go on its own deque and are run newest first, idle workers steal the
+// oldest task of a random victim. Tasks posted from other threads go to a
+// shared queue. instance() is the library-wide pool used by parallelFor,
+// TaskGroup and the async API.
+class ThreadPool {
+private:
+    struct Worker;                                  // deque and counters, defined in Parallel.cpp
+    std::vector<std::unique_ptr<Worker>> deques;    // one per worker
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> injected;     // posted from outside the pool, oldest first
+    std::mutex lock;                                // guards injected, pending and stopping
+    std::condition_variable wake;
+    int pending;                                    // queued tasks, all queues
+    bool stopping;
+
+    void workerLoop(int index);
+    bool take(int self, std::function<void()>& task);   // own deque, shared queue, then steal
+
+public:
+    static ThreadPool& instance();       // shared pool with threadCount() workers
+
+    explicit ThreadPool(int threads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();                       // finishes queued tasks, then joins
+
+    int size() const;                    // number of workers
+    void post(std::function<void()> task);   // run task on some worker, outside any AllocSite
+
+    std::vector<WorkerStats> stats() const;   // snapshot, one entry per worker
+    void resetStats();
+
+    // Run task on some worker; the future carries its result or exception
+    template <class F>
+    auto submit(F task) -> std::future<decltype(task())> {
+        typedef decltype(task()) R;
+        std::shared_ptr<std::packaged_task<R()>> job = std::make_shared<std::packaged_task<R()>>(task);
+        std::future<R> result = job->get_future();
+        const char* site = allocSite(); // charge the task's allocations to the submitter
+        post([job, site]() {
+            AllocSite scope(site);
+            (*job)();
+        });
+        return result;
+    }
+};
+
+// TaskGroup: fork-join over the pool for recursive kernels. spawn() keeps the
+// task in the group and posts a runner for it (on the calling worker's own
+// deque when called from the pool, where idle workers can steal it). wait()
+// runs the group's own tasks that no runner has taken, newest first, then
+// blocks until the rest are done and rethrows the first failure. It never
+// runs another group's task, so a waiter holding a lock cannot re-enter it.
+class TaskGroup {
+private:
+    struct State;                     // tasks and completion, shared with the runners
+    std::shared_ptr<State> state;
+
+    static bool runOne(State& s, bool oldest);   // one unstarted task; false if none
+
+public:
+    TaskGroup();
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    ~TaskGroup();                     // waits for unfinished tasks, dropping their errors
+
+    void spawn(std::function<void()> task);
+    void wait();
+};
+
+// Split [begin, end) into chunks of at least grain items and run body(lo, hi)
+// on each chunk in parallel on the pool, the caller included. Runs inline when
+// the range is too small to split or when called from inside another parallelFor.
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+// Run first and second, the first possibly on a pool worker. If no worker has
+// stolen first by the time second is done, the caller runs it itself.
+void parallelInvoke(const std::function<void()>& first, const std::function<void()>& second);
+
+} // namespace mat
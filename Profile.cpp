@@ -0,0 +1,105 @@
+// avrahamavitan@gmail.com
+#include "Profile.hpp"
+#include "Trace.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+namespace mat {
+
+// Off unless asked for in the environment
+static std::atomic<bool> enabled(std::getenv("SQUAREMAT_PROFILE") != nullptr &&
+                                 std::atoi(std::getenv("SQUAREMAT_PROFILE")) != 0);
+
+// Counters by (operator, bucket)
+static std::map<std::pair<std::string, int>, OpStats> table;
+static std::mutex tableLock;
+
+// Running totals of the calling thread; scopes record their difference
+static thread_local long long threadBytes = 0;
+static thread_local double threadFlops = 0;
+
+// Is profiling on
+bool profilingEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+// Turn profiling on or off
+void setProfiling(bool on) {
+    enabled = on;
+}
+
+// Forget every counter
+void resetProfile() {
+    std::lock_guard<std::mutex> guard(tableLock);
+    table.clear();
+}
+
+// Power-of-two bucket
+int sizeBucket(int n) {
+    int bucket = 1;
+    while (bucket < n) bucket *= 2;
+    return bucket;
+}
+
+// Counters of one operator and bucket
+OpStats operatorStats(const std::string& op, int n) {
+    std::lock_guard<std::mutex> guard(tableLock);
+    std::map<std::pair<std::string, int>, OpStats>::const_iterator it = table.find(std::make_pair(op, sizeBucket(n)));
+    if (it == table.end()) {
+        OpStats none = {0, 0, 0, 0};
+        return none;
+    }
+    return it->second;
+}
+
+// All counters as JSON, ordered by operator then bucket
+std::string profileJson() {
+    std::lock_guard<std::mutex> guard(tableLock);
+    std::ostringstream out;
+    out << "[";
+    bool first = true;
+    for (std::map<std::pair<std::string, int>, OpStats>::const_iterator it = table.begin(); it != table.end(); ++it) {
+        const OpStats& s = it->second;
+        out << (first ? "" : ",") << "\n  {\"op\": \"" << it->first.first << "\", \"bucket\": " << it->first.second
+            << ", \"calls\": " << s.calls << ", \"bytes\": " << s.bytes << ", \"flops\": " << s.flops
+            << ", \"seconds\": " << s.seconds << "}";
+        first = false;
+    }
+    out << (first ? "]" : "\n]");
+    return out.str();
+}
+
+// Allocation hook: only counted while profiling
+void profileAllocation(size_t bytes) {
+    if (profilingEnabled()) threadBytes += static_cast<long long>(bytes);
+}
+
+// Start measuring
+OpScope::OpScope(const char* op, int n, double flops)
+    : op(op), n(n), site(op), active(profilingEnabled()), traced(tracingEnabled()), bytesBefore(0), flopsBefore(0) {
+    if (traced) traceBegin(op, n, -1);
+    if (!active) return;
+    bytesBefore = threadBytes;
+    flopsBefore = threadFlops;
+    threadFlops += flops;
+    start = std::chrono::steady_clock::now();
+}
+
+// Add this call to its operator's counters
+OpScope::~OpScope() {
+    if (traced) traceEnd();
+    if (!active) return;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> guard(tableLock);
+    OpStats& s = table[std::make_pair(std::string(op), sizeBucket(n))];
+    ++s.calls;
+    s.bytes += threadBytes - bytesBefore;
+    s.flops += threadFlops - flopsBefore;
+    s.seconds += seconds;
+}
+
+} // namespace mat
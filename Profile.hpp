@@ -0,0 +1,61 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "Alloc.hpp"
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace mat {
+
+// Counters of one operator for one size bucket
+struct OpStats {
+    long long calls;
+    long long bytes;     // value blocks allocated during the calls
+    double flops;        // nominal floating-point operations
+    double seconds;      // wall time
+};
+
+// Operator profiling is off unless SQUAREMAT_PROFILE=1 or setProfiling(true).
+// Figures are inclusive: a power counts the time, bytes and flops of the
+// multiplies it performs (which are also counted under "*").
+bool profilingEnabled();
+void setProfiling(bool on);
+void resetProfile();
+
+int sizeBucket(int n);   // bucket of dimension n: smallest power of two >= n
+
+// Counters of op (its symbol, e.g. "*", "^", "+=") for the bucket of n;
+// all zero if it was never recorded
+OpStats operatorStats(const std::string& op, int n);
+
+// Every recorded counter as a JSON array of
+// {"op", "bucket", "calls", "bytes", "flops", "seconds"} objects
+std::string profileJson();
+
+// Called by the allocator for every value block
+void profileAllocation(size_t bytes);
+
+// OpScope: measures one operator call from construction to destruction, and
+// records it as a trace event when tracing is on. Costs two flag checks when
+// both are off.
+class OpScope {
+private:
+    const char* op;
+    int n;
+    AllocSite site;          // charges the call's allocations to op
+    bool active;
+    bool traced;
+    std::chrono::steady_clock::time_point start;
+    long long bytesBefore;   // this thread's allocation total at start
+    double flopsBefore;      // this thread's flop total at start
+
+public:
+    OpScope(const char* op, int n, double flops);   // flops done by the call itself
+    OpScope(const OpScope&) = delete;
+    OpScope& operator=(const OpScope&) = delete;
+    ~OpScope();
+};
+
+} // namespace mat
@@ -1,39 +1,115 @@
 // avrahamavitan@gmail.com
 #include "SquareMat.hpp"
+#include "LU.hpp"
+#include "MatView.hpp"
+#include "Parallel.hpp"
+#include "Alloc.hpp"
+#include "Profile.hpp"
+#include "Trace.hpp"
 #include <cmath>
+#include <limits>
+#include <algorithm>
+#include <vector>
 
 using namespace mat;
 
+// Cofactor minors of at least this size are expanded as work-stealing tasks
+static const int DET_SPAWN_MIN = 9;
+
+// Matrices with this many values are zeroed by several threads (first touch)
+static const size_t FIRST_TOUCH_MIN = 1 << 16;
+
 // Constructor: create n x n matrix, initialize all entries to 0
-SquareMat::SquareMat(int n) : size(n) {
+SquareMat::SquareMat(int n) : size(n), leaked(false) {
     if (n <= 0) throw std::invalid_argument("Invalid matrix size");
     allocate(); // allocate 2D array
-    for (int i = 0; i < size; ++i)
-        for (int j = 0; j < size; ++j)
-            data[i][j] = 0.0; // set each entry to zero
-}
-
-// Allocate memory for data array
+    if (static_cast<size_t>(size) * size < FIRST_TOUCH_MIN) {
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < size; ++j)
+                data[i][j] = 0.0; // set each entry to zero
+        return;
+    }
+    // Large matrices: zero row chunks in parallel, split like gemm splits its
+    // output rows. The page holding a row is placed on the NUMA node of the
+    // thread that first writes it, so the pages spread over the nodes the
+    // kernels later run on (chunks are claimed dynamically, so which thread
+    // gets which chunk is not fixed).
+    double** rows = data;
+    int cols = size;
+    parallelFor(0, size, GEMM_ROW_GRAIN, [rows, cols](int lo, int hi) {
+        for (int i = lo; i < hi; ++i)
+            for (int j = 0; j < cols; ++j)
+                rows[i][j] = 0.0;
+    });
+}
+
+// Allocate memory for data array: one contiguous block, rows point into it.
+// Rows are packed size doubles apart, so only the block start (row 0) carries
+// the policy's alignment. Members change only once every allocation succeeded.
 void SquareMat::allocate() {
-    data = new double*[size]; // array of pointers
+    double* values = allocValues(static_cast<size_t>(size) * size); // all values, row after row, under the allocation policy
+    double** rows = nullptr;
+    std::atomic<int>* count = nullptr;
+    try {
+        rows = new double*[size]; // array of pointers
+        count = new std::atomic<int>(1); // only this matrix uses it
+    } catch (...) {
+        delete[] rows;
+        freeValues(values);
+        throw;
+    }
     for (int i = 0; i < size; ++i)
-        data[i] = new double[size]; // each row is an array of doubles
+        rows[i] = values + static_cast<size_t>(i) * size; // i * size overflows int for n > 46340
+    data = rows;
+    refs = count;
 }
 
-// Free allocated memory
+// Drop this matrix's reference; the last one frees the memory
 void SquareMat::deallocate() {
-    for (int i = 0; i < size; ++i)
-        delete[] data[i]; // delete each row
-    delete[] data;       // delete array of pointers
+    if (refs->fetch_sub(1) == 1) {
+        freeValues(data[0]); // free the value block
+        delete[] data;    // delete array of pointers
+        delete refs;
+    }
 }
 
-// Copy data from other matrix
+// Share data with other matrix: no values are copied, unless other's values
+// are leaked, in which case this matrix gets its own copy
 void SquareMat::copy(const SquareMat& other) {
     size = other.size;   // copy size
-    allocate();          // allocate new memory
-    for (int i = 0; i < size; ++i)
-        for (int j = 0; j < size; ++j)
-            data[i][j] = other.data[i][j]; // copy each value
+    leaked = false;
+    if (other.leaked) {
+        allocate();
+        size_t count = static_cast<size_t>(size) * size;
+        for (size_t i = 0; i < count; ++i)
+            data[0][i] = other.data[0][i];
+        return;
+    }
+    data = other.data;   // same block
+    refs = other.refs;
+    refs->fetch_add(1);
+}
+
+// Copy-on-write: before the first write to a shared block, take a private copy
+void SquareMat::detach() {
+    if (refs->load(std::memory_order_acquire) == 1) return; // already private
+    double** shared = data;
+    std::atomic<int>* sharedRefs = refs;
+    allocate();
+    size_t count = static_cast<size_t>(size) * size; // size * size overflows int for n > 46340
+    for (size_t i = 0; i < count; ++i)
+        data[0][i] = shared[0][i];
+    if (sharedRefs->fetch_sub(1) == 1) {
+        // the other owners went away meanwhile
+        freeValues(shared[0]);
+        delete[] shared;
+        delete sharedRefs;
+    }
+}
+
+// True if both matrices currently share one value block
+bool SquareMat::sharesWith(const SquareMat& other) const {
+    return data == other.data;
 }
 
 // Copy constructor: build from another matrix
@@ -44,8 +120,9 @@ SquareMat::SquareMat(const SquareMat& other) {
 // Assignment operator: clean old data and copy new data
 SquareMat& SquareMat::operator=(const SquareMat& other) {
     if (this != &other) {
+        SquareMat next(other); // a deep copy may throw; this stays valid until it succeeded
         deallocate();  // free existing memory
-        copy(other);   // copy new data
+        copy(next);    // share next's block, cannot throw
     }
     return *this;
 }
@@ -55,9 +132,17 @@ SquareMat::~SquareMat() {
     deallocate();
 }
 
-// Access row by index (non-const)
+// Matrix dimension
+int SquareMat::dim() const {
+    return size;
+}
+
+// Access row by index (non-const): the caller may write, so detach first,
+// and the pointer may outlive this call, so later copies must not share
 double* SquareMat::operator[](int row) {
     if (row < 0 || row >= size) throw std::out_of_range("Row out of range");
+    detach();
+    if (!leaked.load(std::memory_order_relaxed)) leaked.store(true, std::memory_order_relaxed); // write once
     return data[row]; // return pointer to row
 }
 
@@ -69,50 +154,52 @@ const double* SquareMat::operator[](int row) const {
 
 // Add two matrices
 SquareMat SquareMat::operator+(const SquareMat& other) const {
+    OpScope scope("+", size, static_cast<double>(size) * size);
     if (size != other.size) throw std::invalid_argument("Size mismatch");
     SquareMat result(size);
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            result[i][j] = data[i][j] + other.data[i][j];
+            result.data[i][j] = data[i][j] + other.data[i][j];
     return result;
 }
 
 // Subtract two matrices
 SquareMat SquareMat::operator-(const SquareMat& other) const {
+    OpScope scope("-", size, static_cast<double>(size) * size);
     if (size != other.size) throw std::invalid_argument("Size mismatch");
     SquareMat result(size);
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            result[i][j] = data[i][j] - other.data[i][j];
+            result.data[i][j] = data[i][j] - other.data[i][j];
     return result;
 }
 
 // Unary minus: negate each entry
 SquareMat SquareMat::operator-() const {
+    OpScope scope("neg", size, static_cast<double>(size) * size);
     SquareMat result(size);
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            result[i][j] = -data[i][j];
+            result.data[i][j] = -data[i][j];
     return result;
 }
 
 // Matrix multiplication
 SquareMat SquareMat::operator*(const SquareMat& other) const {
+    OpScope scope("*", size, 2.0 * size * size * size);
     if (size != other.size) throw std::invalid_argument("Size mismatch");
     SquareMat result(size);
-    for (int i = 0; i < size; ++i)
-        for (int j = 0; j < size; ++j)
-            for (int k = 0; k < size; ++k)
-                result[i][j] += data[i][k] * other.data[k][j];
+    gemm(1.0, *this, other, 0.0, result);
     return result;
 }
 
 // Scalar multiplication: multiply each entry by scalar
 SquareMat SquareMat::operator*(double scalar) const {
+    OpScope scope("*scalar", size, static_cast<double>(size) * size);
     SquareMat result(size);
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            result[i][j] = data[i][j] * scalar;
+            result.data[i][j] = data[i][j] * scalar;
     return result;
 }
 
@@ -123,41 +210,46 @@ SquareMat operator*(double scalar, const SquareMat& mat) {
 
 // Element-wise multiplication (mod %) with another matrix
 SquareMat SquareMat::operator%(const SquareMat& other) const {
+    OpScope scope("%", size, static_cast<double>(size) * size);
     if (size != other.size) throw std::invalid_argument("Size mismatch");
     SquareMat result(size);
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            result[i][j] = static_cast<int>(data[i][j]) % static_cast<int>(other.data[i][j]);
+            result.data[i][j] = static_cast<int>(data[i][j]) % static_cast<int>(other.data[i][j]);
     return result;
 }
 
 // Modulo each entry by integer
 SquareMat SquareMat::operator%(int mod) const {
+    OpScope scope("%int", size, static_cast<double>(size) * size);
     if (mod == 0) throw std::invalid_argument("Modulo by zero");
     SquareMat result(size);
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            result[i][j] = static_cast<int>(data[i][j]) % mod;
+            result.data[i][j] = static_cast<int>(data[i][j]) % mod;
     return result;
 }
 
 // Divide each entry by scalar
 SquareMat SquareMat::operator/(double scalar) const {
+    OpScope scope("/", size, static_cast<double>(size) * size);
     if (scalar == 0) throw std::invalid_argument("Division by zero");
     SquareMat result(size);
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            result[i][j] = data[i][j] / scalar;
+            result.data[i][j] = data[i][j] / scalar;
     return result;
 }
 
 // Matrix power: raise to non-negative integer power
 SquareMat SquareMat::operator^(int power) const {
+    OpScope scope("^", size, 0); // the multiplies count their own flops
     if (power < 0) throw std::invalid_argument("Negative powers not supported");
     SquareMat result(size);
-    for (int i = 0; i < size; ++i) result[i][i] = 1; // identity
+    for (int i = 0; i < size; ++i) result.data[i][i] = 1; // identity
     SquareMat base(*this);
-    while (power) {
+    for (int step = 0; power; ++step) {
+        TraceScope stepScope("power step", size, step); // one bit of the exponent
         if (power % 2) result = result * base; // multiply when bit is set
         base = base * base; // square base
         power /= 2;
@@ -165,8 +257,219 @@ SquareMat SquareMat::operator^(int power) const {
     return result;
 }
 
+// Householder reduction of symmetric v to tridiagonal form (v is overwritten by Q).
+// On return d holds the diagonal and e the sub-diagonal (e[0] unused).
+static void tridiagonalize(double** v, double* d, double* e, int n) {
+    for (int j = 0; j < n; ++j) d[j] = v[n-1][j];
+    for (int i = n-1; i > 0; --i) {
+        double scale = 0, h = 0;
+        for (int k = 0; k < i; ++k) scale += std::fabs(d[k]);
+        if (scale == 0) {
+            // row already reduced: skip the reflection
+            e[i] = d[i-1];
+            for (int j = 0; j < i; ++j) {
+                d[j] = v[i-1][j];
+                v[i][j] = 0;
+                v[j][i] = 0;
+            }
+        } else {
+            // build the Householder vector
+            for (int k = 0; k < i; ++k) {
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+            double f = d[i-1];
+            double g = std::sqrt(h);
+            if (f > 0) g = -g;
+            e[i] = scale * g;
+            h -= f * g;
+            d[i-1] = f - g;
+            for (int j = 0; j < i; ++j) e[j] = 0;
+            // apply the reflection to the remaining columns
+            for (int j = 0; j < i; ++j) {
+                f = d[j];
+                v[j][i] = f;
+                g = e[j] + v[j][j] * f;
+                for (int k = j+1; k <= i-1; ++k) {
+                    g += v[k][j] * d[k];
+                    e[k] += v[k][j] * f;
+                }
+                e[j] = g;
+            }
+            f = 0;
+            for (int j = 0; j < i; ++j) {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            double hh = f / (h + h);
+            for (int j = 0; j < i; ++j) e[j] -= hh * d[j];
+            for (int j = 0; j < i; ++j) {
+                f = d[j];
+                g = e[j];
+                for (int k = j; k <= i-1; ++k)
+                    v[k][j] -= (f * e[k] + g * d[k]);
+                d[j] = v[i-1][j];
+                v[i][j] = 0;
+            }
+        }
+        d[i] = h;
+    }
+    // accumulate the transformations into v
+    for (int i = 0; i < n-1; ++i) {
+        v[n-1][i] = v[i][i];
+        v[i][i] = 1;
+        double h = d[i+1];
+        if (h != 0) {
+            for (int k = 0; k <= i; ++k) d[k] = v[k][i+1] / h;
+            for (int j = 0; j <= i; ++j) {
+                double g = 0;
+                for (int k = 0; k <= i; ++k) g += v[k][i+1] * v[k][j];
+                for (int k = 0; k <= i; ++k) v[k][j] -= g * d[k];
+            }
+        }
+        for (int k = 0; k <= i; ++k) v[k][i+1] = 0;
+    }
+    for (int j = 0; j < n; ++j) {
+        d[j] = v[n-1][j];
+        v[n-1][j] = 0;
+    }
+    v[n-1][n-1] = 1;
+    e[0] = 0;
+}
+
+// Implicit QL (QR) iteration on the tridiagonal matrix (d, e); rotations are applied to v
+static void tridiagonalQL(double** v, double* d, double* e, int n) {
+    for (int i = 1; i < n; ++i) e[i-1] = e[i];
+    e[n-1] = 0;
+    double f = 0, tst1 = 0;
+    const double eps = std::ldexp(1.0, -52);
+    for (int l = 0; l < n; ++l) {
+        // find a small sub-diagonal element to split the problem
+        tst1 = std::max(tst1, std::fabs(d[l]) + std::fabs(e[l]));
+        int m = l;
+        while (m < n-1 && std::fabs(e[m]) > eps * tst1) ++m;
+        if (m > l) {
+            int iter = 0;
+            do {
+                if (++iter > 60) throw std::runtime_error("Eigenvalue iteration did not converge");
+                // compute the implicit shift
+                double g = d[l];
+                double p = (d[l+1] - g) / (2 * e[l]);
+                double r = std::hypot(p, 1.0);
+                if (p < 0) r = -r;
+                d[l] = e[l] / (p + r);
+                d[l+1] = e[l] * (p + r);
+                double dl1 = d[l+1];
+                double h = g - d[l];
+                for (int i = l+2; i < n; ++i) d[i] -= h;
+                f += h;
+                // chase the bulge with Givens rotations
+                p = d[m];
+                double c = 1, c2 = 1, c3 = 1, s = 0, s2 = 0;
+                double el1 = e[l+1];
+                for (int i = m-1; i >= l; --i) {
+                    c3 = c2;
+                    c2 = c;
+                    s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = std::hypot(p, e[i]);
+                    e[i+1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i+1] = h + s * (c * g + s * d[i]);
+                    for (int k = 0; k < n; ++k) {
+                        h = v[k][i+1];
+                        v[k][i+1] = s * v[k][i] + c * h;
+                        v[k][i] = c * v[k][i] - s * h;
+                    }
+                }
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+            } while (std::fabs(e[l]) > eps * tst1);
+        }
+        d[l] += f;
+        e[l] = 0;
+    }
+}
+
+// Symmetry check: exact comparison with the transpose
+bool SquareMat::isSymmetric() const {
+    for (int i = 0; i < size; ++i)
+        for (int j = i+1; j < size; ++j)
+            if (data[i][j] != data[j][i]) return false;
+    return true;
+}
+
+// Symmetric up to rounding: |a_ij - a_ji| <= n * eps * max|a|, so products
+// like B * B^T that differ from their transpose in the last bits are accepted
+bool SquareMat::isNearlySymmetric() const {
+    double largest = 0;
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j) largest = std::max(largest, std::fabs(data[i][j]));
+    double tolerance = size * std::numeric_limits<double>::epsilon() * largest;
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < i; ++j)
+            if (!(std::fabs(data[i][j] - data[j][i]) <= tolerance)) return false; // NaN fails too
+    return true;
+}
+
+// Eigendecomposition of a symmetric matrix: A = V * diag(values) * V^T.
+// values must hold size entries; vectors receives V (eigenvectors as columns).
+void SquareMat::symmetricEigen(double* values, SquareMat& vectors) const {
+    if (!isSymmetric()) throw std::invalid_argument("Matrix is not symmetric");
+    if (vectors.size != size) throw std::invalid_argument("Size mismatch");
+    vectors = *this;
+    vectors.detach(); // written in place below
+    double* e = new double[size];
+    try {
+        tridiagonalize(vectors.data, values, e, size);
+        tridiagonalQL(vectors.data, values, e, size);
+    } catch (...) {
+        delete[] e;
+        throw;
+    }
+    delete[] e;
+}
+
+// Symmetric power: V * diag(values^power) * V^T, cost independent of power.
+// Only on request: the result carries eigensolver rounding, while ^ stays exact
+// for integer matrices.
+SquareMat SquareMat::symmetricPower(int power) const {
+    if (power < 0) throw std::invalid_argument("Negative powers not supported");
+    SquareMat v(size);
+    double* values = new double[size];
+    try {
+        symmetricEigen(values, v);
+    } catch (...) {
+        delete[] values;
+        throw;
+    }
+    SquareMat scaled(size); // V with column k scaled by values[k]^power
+    for (int k = 0; k < size; ++k) {
+        double p = std::pow(values[k], power);
+        for (int i = 0; i < size; ++i)
+            scaled.data[i][k] = v.data[i][k] * p;
+    }
+    delete[] values;
+    SquareMat result(size);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j <= i; ++j) {
+            double sum = 0;
+            for (int k = 0; k < size; ++k)
+                sum += scaled.data[i][k] * v.data[j][k];
+            result.data[i][j] = sum;
+            result.data[j][i] = sum; // result is symmetric too
+        }
+    return result;
+}
+
 // Pre-increment: add 1 to each entry
 SquareMat& SquareMat::operator++() {
+    OpScope scope("++", size, static_cast<double>(size) * size);
+    detach();
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
             ++data[i][j];
@@ -182,6 +485,8 @@ SquareMat SquareMat::operator++(int) {
 
 // Pre-decrement: subtract 1 from each entry
 SquareMat& SquareMat::operator--() {
+    OpScope scope("--", size, static_cast<double>(size) * size);
+    detach();
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
             --data[i][j];
@@ -197,42 +502,147 @@ SquareMat SquareMat::operator--(int) {
 
 // Transpose matrix: swap rows and columns
 SquareMat SquareMat::operator~() const {
+    OpScope scope("~", size, 0);
     SquareMat result(size);
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            result[i][j] = data[j][i];
+            result.data[i][j] = data[j][i];
     return result;
 }
 
-// Helper: compute determinant recursively
-double SquareMat::calcDeterminant(double** mat, int n) const {
-    if (n == 1) return mat[0][0];
-    if (n == 2) return mat[0][0]*mat[1][1] - mat[0][1]*mat[1][0];
+// Helper: cofactor expansion along row `row` over the n columns in cols.
+// Minors are described by column lists, not copied; work holds the column
+// lists of deeper levels (n*(n-1)/2 ints). Zero terms are skipped only when
+// skipZeros is set, i.e. every entry is finite, so 0 * Inf and 0 * NaN still
+// give NaN as in gemm.
+double SquareMat::calcDeterminant(int row, const int* cols, int n, int* work, bool skipZeros) const {
+    const double* r = data[row];
+    if (n == 1) return r[cols[0]];
+    const double* next = data[row + 1];
+    if (n == 2) return r[cols[0]]*next[cols[1]] - r[cols[1]]*next[cols[0]];
     double det = 0;
     for (int p = 0; p < n; ++p) {
-        // build submatrix for minor
-        double** submat = new double*[n-1];
-        for (int i = 0; i < n-1; ++i)
-            submat[i] = new double[n-1];
-        for (int i = 1; i < n; ++i) {
-            int colIdx = 0;
-            for (int j = 0; j < n; ++j) {
-                if (j == p) continue;
-                submat[i-1][colIdx++] = mat[i][j];
-            }
-        }
+        if (skipZeros && r[cols[p]] == 0) continue; // zero term, skip its minor
+        // columns of the minor: all but cols[p]
+        int colIdx = 0;
+        for (int j = 0; j < n; ++j)
+            if (j != p) work[colIdx++] = cols[j];
         double sign = (p % 2 == 0) ? 1 : -1; // alternating signs
-        det += sign * mat[0][p] * calcDeterminant(submat, n-1);
-        // free submatrix memory
-        for (int i = 0; i < n-1; ++i) delete[] submat[i];
-        delete[] submat;
+        det += sign * r[cols[p]] * calcDeterminant(row + 1, work, n-1, work + (n-1), skipZeros);
+    }
+    return det;
+}
+
+// Cofactor expansion with one task per nonzero term while minors are large.
+// Skipped zeros make the subtrees uneven, which idle workers balance by
+// stealing. Terms are summed in column order, so the result is deterministic.
+double SquareMat::spawnDeterminant(int row, const int* cols, int n, bool skipZeros) const {
+    if (n < DET_SPAWN_MIN || threadCount() == 1) {
+        int* work = new int[n * (n - 1) / 2 + 1];
+        double det = calcDeterminant(row, cols, n, work, skipZeros);
+        delete[] work;
+        return det;
+    }
+    const double* r = data[row];
+    std::vector<double> terms(n, 0.0);
+    std::vector<int> minors(n * (n - 1));   // columns of each minor
+    TaskGroup group;
+    for (int p = 0; p < n; ++p) {
+        if (skipZeros && r[cols[p]] == 0) continue; // zero term, skip its minor
+        int* minor = &minors[p * (n - 1)];
+        int colIdx = 0;
+        for (int j = 0; j < n; ++j)
+            if (j != p) minor[colIdx++] = cols[j];
+        group.spawn([this, r, row, cols, p, n, minor, skipZeros, &terms]() {
+            TraceScope task("cofactor", n - 1, p);
+            double sign = (p % 2 == 0) ? 1 : -1;
+            terms[p] = sign * r[cols[p]] * spawnDeterminant(row + 1, minor, n - 1, skipZeros);
+        });
     }
+    group.wait();
+    double det = 0;
+    for (int p = 0; p < n; ++p) det += terms[p];
     return det;
 }
 
+// Nominal flops of the cofactor expansion: one multiply-add per term at
+// every level, n + n(n-1) + ... + n!
+static double determinantFlops(int n) {
+    double terms = 1, total = 0;
+    for (int k = n; k > 2; --k) {
+        terms *= k;
+        total += 2 * terms;
+    }
+    if (n == 1) return 0;
+    return total + 3 * terms; // 2x2 minors: two products and a difference
+}
+
 // Determinant operator
 double SquareMat::operator!() const {
-    return calcDeterminant(data, size);
+    OpScope scope("!", size, determinantFlops(size));
+    int* cols = new int[size];
+    for (int j = 0; j < size; ++j) cols[j] = j;
+    bool finite = true; // zero terms may be skipped only if no minor can be Inf or NaN
+    for (int i = 0; i < size && finite; ++i)
+        for (int j = 0; j < size; ++j)
+            if (!std::isfinite(data[i][j])) finite = false;
+    double det = spawnDeterminant(0, cols, size, finite);
+    delete[] cols;
+    return det;
+}
+
+// Log-determinant from one LU factorization
+double SquareMat::logdet() const {
+    return LU(*this).logdet();
+}
+
+// Sign and log-magnitude of the determinant from one LU factorization
+double SquareMat::slogdet(int& sign) const {
+    return LU(*this).slogdet(sign);
+}
+
+// Exact determinant for integer entries: Bareiss fraction-free elimination.
+// Every intermediate entry is a minor of the matrix, so the divisions are exact;
+// products are formed in 128 bits and checked for overflow.
+long long SquareMat::exactDeterminant() const {
+    const double limit = 9223372036854775807.0; // 2^63
+    std::vector<__int128> m(static_cast<size_t>(size) * size);
+    auto at = [&m, this](int i, int j) -> __int128& { return m[static_cast<size_t>(i) * size + j]; };
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j) {
+            double v = data[i][j];
+            if (v != std::floor(v) || std::fabs(v) >= limit)
+                throw std::invalid_argument("Matrix entries must be integers");
+            at(i, j) = static_cast<long long>(v);
+        }
+    int sign = 1;
+    __int128 prev = 1; // previous pivot
+    for (int k = 0; k < size - 1; ++k) {
+        if (at(k, k) == 0) {
+            // find a row with a nonzero pivot and swap it in
+            int p = k + 1;
+            while (p < size && at(p, k) == 0) ++p;
+            if (p == size) return 0; // whole column is zero
+            for (int j = 0; j < size; ++j) std::swap(at(k, j), at(p, j));
+            sign = -sign;
+        }
+        __int128 pivot = at(k, k);
+        for (int i = k + 1; i < size; ++i)
+            for (int j = k + 1; j < size; ++j) {
+                // m[i][j] = (m[i][j] * pivot - m[i][k] * m[k][j]) / prev
+                __int128 a, b, diff;
+                if (__builtin_mul_overflow(at(i, j), pivot, &a) ||
+                    __builtin_mul_overflow(at(i, k), at(k, j), &b) ||
+                    __builtin_sub_overflow(a, b, &diff))
+                    throw std::overflow_error("Determinant overflow");
+                at(i, j) = diff / prev;
+            }
+        prev = pivot;
+    }
+    __int128 det = at(size - 1, size - 1) * sign;
+    const __int128 maxLL = 9223372036854775807LL;
+    if (det > maxLL || det < -maxLL - 1) throw std::overflow_error("Determinant overflow");
+    return static_cast<long long>(det);
 }
 
 // Equality: compare sums of entries
@@ -279,42 +689,94 @@ bool SquareMat::operator>=(const SquareMat& other) const {
 
 // Compound add
 SquareMat& SquareMat::operator+=(const SquareMat& other) {
-    return *this = *this + other;
+    OpScope scope("+=", size, static_cast<double>(size) * size);
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    detach();
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            data[i][j] += other.data[i][j]; // in place, no temporary
+    return *this;
 }
 
 // Compound subtract
 SquareMat& SquareMat::operator-=(const SquareMat& other) {
-    return *this = *this - other;
+    OpScope scope("-=", size, static_cast<double>(size) * size);
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    detach();
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            data[i][j] -= other.data[i][j];
+    return *this;
 }
 
 // Compound multiply by matrix
 SquareMat& SquareMat::operator*=(const SquareMat& other) {
+    OpScope scope("*=", size, 0); // counted by the multiply
     return *this = *this * other;
 }
 
 // Compound multiply by scalar
 SquareMat& SquareMat::operator*=(double scalar) {
-    return *this = *this * scalar;
+    OpScope scope("*=scalar", size, static_cast<double>(size) * size);
+    detach();
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            data[i][j] *= scalar;
+    return *this;
 }
 
 // Compound divide by scalar
 SquareMat& SquareMat::operator/=(double scalar) {
-    return *this = *this / scalar;
+    OpScope scope("/=", size, static_cast<double>(size) * size);
+    if (scalar == 0) throw std::invalid_argument("Division by zero");
+    detach();
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            data[i][j] /= scalar;
+    return *this;
 }
 
 // Compound element-wise multiply
 SquareMat& SquareMat::operator%=(const SquareMat& other) {
-    return *this = *this % other;
+    OpScope scope("%=", size, static_cast<double>(size) * size);
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    detach();
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            data[i][j] = static_cast<int>(data[i][j]) % static_cast<int>(other.data[i][j]);
+    return *this;
 }
 
 // Compound modulo by scalar
 SquareMat& SquareMat::operator%=(int mod) {
-    return *this = *this % mod;
+    OpScope scope("%=int", size, static_cast<double>(size) * size);
+    if (mod == 0) throw std::invalid_argument("Modulo by zero");
+    detach();
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            data[i][j] = static_cast<int>(data[i][j]) % mod;
+    return *this;
 }
 
-// Stream operators in namespace mat
+// Stream operators and gemm in namespace mat
 namespace mat {
 
+// Private block for a library kernel; the matrix is not marked leaked
+double* KernelAccess::values(SquareMat& mat) {
+    mat.detach();
+    return mat.data[0];
+}
+
+// C = alpha * op(A) * op(B) + beta * C: make c private, then run the view kernel
+void gemm(double alpha, const SquareMat& a, const SquareMat& b, double beta, SquareMat& c,
+          bool transA, bool transB) {
+    if (a.size != c.size || b.size != c.size) throw std::invalid_argument("Size mismatch");
+    if (&c == &a || &c == &b) throw std::invalid_argument("Output aliases an input");
+    // c may share values with a copy; the view is internal, so c stays shareable
+    gemm(alpha, ConstMatView(a), ConstMatView(b), beta, MatView(KernelAccess::values(c), c.size, c.size),
+         transA, transB);
+}
+
 // Output matrix to stream
 std::ostream& operator<<(std::ostream& os, const SquareMat& mat) {
     for (int i = 0; i < mat.size; ++i) {
@@ -328,6 +790,7 @@ std::ostream& operator<<(std::ostream& os, const SquareMat& mat) {
 
 // Input matrix from stream
 std::istream& operator>>(std::istream& in, SquareMat& mat) {
+    mat.detach();
     for (int i = 0; i < mat.size; ++i) {
         for (int j = 0; j < mat.size; ++j) {
             double val;
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <atomic>
 
 namespace mat {
 
@@ -11,19 +12,33 @@ namespace mat {
 class SquareMat {
 private:
     int size;        // dimension of matrix
-    double** data;   // 2D array of values
+    double** data;   // row pointers into one contiguous block of values (row 0 aligned, rows packed)
+    std::atomic<int>* refs; // matrices sharing this block (copy-on-write)
+    std::atomic<bool> leaked; // a writable row pointer or view was handed out: copies are deep
 
     void allocate();
     void deallocate();
     void copy(const SquareMat& other);
-    double calcDeterminant(double** mat, int n) const;
+    void detach();   // make a private copy of the block before writing
+    double calcDeterminant(int row, const int* cols, int n, int* work, bool skipZeros) const;
+    double spawnDeterminant(int row, const int* cols, int n, bool skipZeros) const;   // top levels as pool tasks
 
 public:
     SquareMat(int size);                  // create zero matrix
-    SquareMat(const SquareMat& other);    // copy constructor
+    SquareMat(const SquareMat& other);    // copy constructor, O(1): shares the values (deep after a leak)
     SquareMat& operator=(const SquareMat& other);
     ~SquareMat();                         // destructor
 
+    int dim() const;                      // matrix dimension
+
+    bool sharesWith(const SquareMat& other) const; // true if both use the same value block
+
+    // Non-const access makes the values private first (copy-on-write) and marks
+    // them leaked: the row pointer may be written later, so from then on copies
+    // of this matrix take their own values instead of sharing. Assigning a new
+    // value to the matrix makes it shareable again. Once the matrix is private
+    // and leaked the call only reads, but the first call may detach: fetch rows
+    // before handing the matrix to several threads.
     double* operator[](int index);        // access row
     const double* operator[](int index) const;
 
@@ -56,6 +71,14 @@ public:
     bool operator>=(const SquareMat& other) const;
 
     double operator!() const;
+    double logdet() const;                // log(det) via LU, NaN if det < 0
+    double slogdet(int& sign) const;      // log|det| via LU, sign set to -1, 0 or +1
+    long long exactDeterminant() const;   // exact determinant of an integer matrix (Bareiss)
+
+    bool isSymmetric() const;                             // true if equal to own transpose
+    bool isNearlySymmetric() const;                       // same, up to n * eps * max|a| (rounding)
+    void symmetricEigen(double* values, SquareMat& vectors) const; // eigenvalues + eigenvectors (columns)
+    SquareMat symmetricPower(int power) const;            // power via eigendecomposition (approximate)
 
     SquareMat& operator+=(const SquareMat& other);
     SquareMat& operator-=(const SquareMat& other);
@@ -65,8 +88,25 @@ public:
     SquareMat& operator%=(const SquareMat& other);
     SquareMat& operator%=(int mod);
 
+    friend struct KernelAccess;
+    friend void gemm(double alpha, const SquareMat& a, const SquareMat& b, double beta, SquareMat& c,
+                     bool transA, bool transB);
     friend std::ostream& operator<<(std::ostream& os, const SquareMat& mat);
     friend std::istream& operator>>(std::istream& in, SquareMat& mat);
 };
 
+// KernelAccess: write access for the library's own kernels. values() makes the
+// block private (copy-on-write) and returns its start, row after row, without
+// marking the matrix leaked, so results stay shareable. The pointer must not
+// outlive the kernel; fetch it once, before any parallel loop.
+struct KernelAccess {
+    static double* values(SquareMat& mat);
+};
+
+// Fused multiply-accumulate: C = alpha * op(A) * op(B) + beta * C, where op
+// transposes when the flag is set. Writes into c without temporaries; c must
+// not be a or b.
+void gemm(double alpha, const SquareMat& a, const SquareMat& b, double beta, SquareMat& c,
+          bool transA = false, bool transB = false);
+
 } // namespace mat
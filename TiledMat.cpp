@@ -0,0 +1,258 @@
+// avrahamavitan@gmail.com
+#include "TiledMat.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace mat;
+
+const int TiledMat::DEFAULT_TILE;
+
+// Constructor: create n x n zero matrix split into tile x tile blocks
+TiledMat::TiledMat(int n, int tile) : size(n), tile(tile) {
+    if (n <= 0) throw std::invalid_argument("Invalid matrix size");
+    if (tile <= 0) throw std::invalid_argument("Invalid tile size");
+    tiles = (n + tile - 1) / tile;
+    allocate();
+}
+
+// Build from a SquareMat by copying each tile's rows
+TiledMat::TiledMat(const SquareMat& mat, int tile) : TiledMat(mat.dim(), tile) {
+    for (int i = 0; i < size; ++i) {
+        const double* row = mat[i];
+        for (int tj = 0; tj < tiles; ++tj) {
+            double* dst = rowOf(i, tj);
+            int j0 = tj * tile;
+            int count = (size - j0 < tile) ? size - j0 : tile;
+            for (int j = 0; j < count; ++j) dst[j] = row[j0 + j];
+        }
+    }
+}
+
+// Allocate zero tiles
+void TiledMat::allocate() {
+    grid = new SquareMat*[tiles * tiles];
+    for (int t = 0; t < tiles * tiles; ++t) grid[t] = new SquareMat(tile);
+}
+
+// Free all tiles
+void TiledMat::deallocate() {
+    for (int t = 0; t < tiles * tiles; ++t) delete grid[t];
+    delete[] grid;
+}
+
+// Copy tiles from other matrix
+void TiledMat::copy(const TiledMat& other) {
+    size = other.size;
+    tile = other.tile;
+    tiles = other.tiles;
+    grid = new SquareMat*[tiles * tiles];
+    for (int t = 0; t < tiles * tiles; ++t) grid[t] = new SquareMat(*other.grid[t]);
+}
+
+// Copy constructor
+TiledMat::TiledMat(const TiledMat& other) {
+    copy(other);
+}
+
+// Assignment operator: clean old tiles and copy new ones
+TiledMat& TiledMat::operator=(const TiledMat& other) {
+    if (this != &other) {
+        deallocate();
+        copy(other);
+    }
+    return *this;
+}
+
+// Destructor: free memory
+TiledMat::~TiledMat() {
+    deallocate();
+}
+
+// Matrix dimension
+int TiledMat::dim() const {
+    return size;
+}
+
+// Dimension of one tile
+int TiledMat::tileSize() const {
+    return tile;
+}
+
+// Tiles per side
+int TiledMat::tileCount() const {
+    return tiles;
+}
+
+// Tile at (ti, tj) (non-const)
+SquareMat& TiledMat::block(int ti, int tj) {
+    if (ti < 0 || ti >= tiles || tj < 0 || tj >= tiles) throw std::out_of_range("Tile out of range");
+    return *grid[ti * tiles + tj];
+}
+
+// Tile at (ti, tj) (const version)
+const SquareMat& TiledMat::block(int ti, int tj) const {
+    if (ti < 0 || ti >= tiles || tj < 0 || tj >= tiles) throw std::out_of_range("Tile out of range");
+    return *grid[ti * tiles + tj];
+}
+
+// Read one entry
+double TiledMat::get(int row, int col) const {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    const SquareMat& t = *grid[(row / tile) * tiles + col / tile];
+    return t[row % tile][col % tile];
+}
+
+// Write one entry
+void TiledMat::set(int row, int col, double value) {
+    if (row < 0 || row >= size || col < 0 || col >= size) throw std::out_of_range("Index out of range");
+    rowOf(row, col / tile)[col % tile] = value;
+}
+
+// Gather the tiles back into one SquareMat
+SquareMat TiledMat::toSquareMat() const {
+    SquareMat result(size);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < size; ++i) {
+        double* row = out + static_cast<size_t>(i) * size;
+        for (int tj = 0; tj < tiles; ++tj) {
+            const double* src = block(i / tile, tj)[i % tile];
+            int j0 = tj * tile;
+            int count = (size - j0 < tile) ? size - j0 : tile;
+            for (int j = 0; j < count; ++j) row[j0 + j] = src[j];
+        }
+    }
+    return result;
+}
+
+// Add tile by tile
+TiledMat TiledMat::operator+(const TiledMat& other) const {
+    if (size != other.size || tile != other.tile) throw std::invalid_argument("Size mismatch");
+    TiledMat result(*this);
+    for (int t = 0; t < tiles * tiles; ++t) *result.grid[t] += *other.grid[t];
+    return result;
+}
+
+// Multiply: C(i,j) += A(i,k) * B(k,j) for each k; output tiles are independent
+// so they are spread across threads, and each tile triple stays in cache
+TiledMat TiledMat::operator*(const TiledMat& other) const {
+    if (size != other.size || tile != other.tile) throw std::invalid_argument("Size mismatch");
+    TiledMat result(size, tile);
+    parallelFor(0, tiles * tiles, 1, [&](int lo, int hi) {
+        for (int t = lo; t < hi; ++t) {
+            TraceScope product("tile product", tile, t);
+            int ti = t / tiles, tj = t % tiles;
+            for (int k = 0; k < tiles; ++k)
+                gemm(1.0, *grid[ti * tiles + k], *other.grid[k * tiles + tj], 1.0, *result.grid[t]);
+        }
+    });
+    return result;
+}
+
+// Transpose: tile (i,j) of the result is the transpose of tile (j,i)
+TiledMat TiledMat::operator~() const {
+    TiledMat result(size, tile);
+    parallelFor(0, tiles * tiles, 1, [&](int lo, int hi) {
+        for (int t = lo; t < hi; ++t) {
+            int ti = t / tiles, tj = t % tiles;
+            *result.grid[t] = ~*grid[tj * tiles + ti];
+        }
+    });
+    return result;
+}
+
+// Row of the matrix stored in tile column tj; the tile stays shareable
+double* TiledMat::rowOf(int row, int tj) {
+    return KernelAccess::values(*grid[(row / tile) * tiles + tj]) + static_cast<size_t>(row % tile) * tile;
+}
+
+// Swap two whole rows, every tile column
+void TiledMat::swapRows(int r1, int r2) {
+    for (int tj = 0; tj < tiles; ++tj) {
+        double* a = rowOf(r1, tj);
+        double* b = rowOf(r2, tj);
+        for (int j = 0; j < tile; ++j) std::swap(a[j], b[j]);
+    }
+}
+
+// Right-looking blocked LU, one tile column at a time: factor the panel with
+// row pivoting, solve the tile row of U against the panel's unit lower
+// triangle, then update the trailing tiles with one gemm each, in parallel.
+// Padding rows and columns stay zero throughout.
+bool TiledMat::factorLU(std::vector<int>& perm, int& sign) {
+    perm.resize(size);
+    for (int i = 0; i < size; ++i) perm[i] = i;
+    sign = 1;
+    double largest = 0;
+    for (int i = 0; i < size; ++i)
+        for (int tj = 0; tj < tiles; ++tj) {
+            const double* row = rowOf(i, tj);
+            for (int j = 0; j < tile; ++j) largest = std::max(largest, std::fabs(row[j]));
+        }
+    double tolerance = size * std::numeric_limits<double>::epsilon() * largest;
+    bool regular = true;
+    for (int kt = 0; kt < tiles; ++kt) {
+        TraceScope step("tiled LU step", tile, kt);
+        int k0 = kt * tile;
+        int width = std::min(tile, size - k0);
+        // panel: columns k0 .. k0+width-1, every row below the diagonal
+        for (int c = k0; c < k0 + width; ++c) {
+            int cc = c - k0, p = c;
+            for (int i = c + 1; i < size; ++i)
+                if (std::fabs(rowOf(i, kt)[cc]) > std::fabs(rowOf(p, kt)[cc])) p = i;
+            if (p != c) {
+                swapRows(c, p);
+                std::swap(perm[c], perm[p]);
+                sign = -sign;
+            }
+            const double* pivotRow = rowOf(c, kt);
+            double pivot = pivotRow[cc];
+            if (std::fabs(pivot) <= tolerance) regular = false;
+            if (pivot == 0) continue; // column already eliminated
+            for (int i = c + 1; i < size; ++i) {
+                double* rowI = rowOf(i, kt);
+                double factor = rowI[cc] / pivot;
+                rowI[cc] = factor;
+                for (int j = cc + 1; j < width; ++j) rowI[j] -= factor * pivotRow[j];
+            }
+        }
+        if (kt + 1 == tiles) break;
+        // U tiles right of the panel: forward substitution with unit L(kt, kt)
+        const SquareMat& diag = *grid[kt * tiles + kt];
+        parallelFor(kt + 1, tiles, 1, [&](int lo, int hi) {
+            for (int tj = lo; tj < hi; ++tj) {
+                double* u = KernelAccess::values(*grid[kt * tiles + tj]); // this worker's own tile
+                for (int i = 1; i < width; ++i) {
+                    double* ui = u + static_cast<size_t>(i) * tile;
+                    for (int k = 0; k < i; ++k) {
+                        double lik = diag[i][k];
+                        const double* uk = u + static_cast<size_t>(k) * tile;
+                        for (int j = 0; j < tile; ++j) ui[j] -= lik * uk[j];
+                    }
+                }
+            }
+        });
+        // trailing tiles: A(i, j) -= L(i, kt) * U(kt, j)
+        int rest = tiles - kt - 1;
+        parallelFor(0, rest * rest, 1, [&](int lo, int hi) {
+            for (int t = lo; t < hi; ++t) {
+                int ti = kt + 1 + t / rest, tj = kt + 1 + t % rest;
+                gemm(-1.0, *grid[ti * tiles + kt], *grid[kt * tiles + tj], 1.0, *grid[ti * tiles + tj]);
+            }
+        });
+    }
+    return regular;
+}
+
+// Determinant: product of U's diagonal, signed by the row swaps
+double TiledMat::determinant() const {
+    TiledMat factors(*this);
+    std::vector<int> perm;
+    int sign;
+    factors.factorLU(perm, sign);
+    double det = sign;
+    for (int i = 0; i < size; ++i) det *= factors.rowOf(i, i / tile)[i % tile];
+    return det;
+}
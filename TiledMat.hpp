@@ -0,0 +1,57 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+#include <vector>
+
+namespace mat {
+
+// TiledMat: large square matrix stored as a grid of square tiles. Each tile is
+// an ordinary SquareMat (one contiguous block), so tile kernels are the regular
+// SquareMat operators and gemm. Edge tiles are padded with zeros.
+class TiledMat {
+private:
+    int size;            // dimension of matrix
+    int tile;            // dimension of each tile
+    int tiles;           // tiles per side
+    SquareMat** grid;    // tiles row by row: grid[ti * tiles + tj]
+
+    void allocate();
+    void deallocate();
+    void copy(const TiledMat& other);
+    double* rowOf(int row, int tj);      // row of the matrix inside tile column tj
+    void swapRows(int r1, int r2);
+
+public:
+    static const int DEFAULT_TILE = 64;   // three 64x64 tiles (96 KB) fit in L2
+
+    TiledMat(int size, int tile = DEFAULT_TILE);             // create zero matrix
+    explicit TiledMat(const SquareMat& mat, int tile = DEFAULT_TILE);
+    TiledMat(const TiledMat& other);                          // copy constructor
+    TiledMat& operator=(const TiledMat& other);
+    ~TiledMat();                                              // destructor
+
+    int dim() const;                     // matrix dimension
+    int tileSize() const;                // dimension of one tile
+    int tileCount() const;               // tiles per side
+    SquareMat& block(int ti, int tj);    // tile at grid position (ti, tj)
+    const SquareMat& block(int ti, int tj) const;
+
+    double get(int row, int col) const;
+    void set(int row, int col, double value);
+    SquareMat toSquareMat() const;
+
+    TiledMat operator+(const TiledMat& other) const;
+    TiledMat operator*(const TiledMat& other) const;   // one gemm per tile triple, tiles in parallel
+    TiledMat operator~() const;                         // transpose tiles and swap their positions
+
+    // Blocked LU with partial pivoting, in place: P*A = L*U with L (unit lower,
+    // below the diagonal) and U left in the tiles as LU packs them. perm[i] is
+    // the original row now at row i and sign the parity of the swaps. Returns
+    // false if a pivot was zero to working precision.
+    bool factorLU(std::vector<int>& perm, int& sign);
+    double determinant() const;                         // factorLU on a copy
+};
+
+} // namespace mat
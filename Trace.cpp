@@ -0,0 +1,118 @@
+// avrahamavitan@gmail.com
+#include "Trace.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace mat {
+
+// One begin ('B') or end ('E') event
+struct TraceEvent {
+    const char* name;   // begin only
+    char phase;
+    double micros;      // since the trace clock started
+    int thread;
+    int n;
+    long part;
+};
+
+// Off unless asked for in the environment
+static std::atomic<bool> enabled(std::getenv("SQUAREMAT_TRACE") != nullptr &&
+                                 std::atoi(std::getenv("SQUAREMAT_TRACE")) != 0);
+
+static std::vector<TraceEvent> events;
+static std::mutex eventsLock;
+static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+static std::atomic<int> nextThread(1);
+
+// Small stable id for the calling thread, in order of first event
+static int threadId() {
+    static thread_local int id = nextThread.fetch_add(1);
+    return id;
+}
+
+// Microseconds on the trace clock
+static double now() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+}
+
+// Append one event
+static void record(const char* name, char phase, int n, long part) {
+    TraceEvent e = {name, phase, now(), threadId(), n, part};
+    std::lock_guard<std::mutex> guard(eventsLock);
+    events.push_back(e);
+}
+
+// Is tracing on
+bool tracingEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+// Turn tracing on or off
+void setTracing(bool on) {
+    enabled = on;
+}
+
+// Forget recorded events
+void clearTrace() {
+    std::lock_guard<std::mutex> guard(eventsLock);
+    events.clear();
+}
+
+// Events in Chrome trace JSON
+std::string traceJson() {
+    std::lock_guard<std::mutex> guard(eventsLock);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3); // timestamps in microseconds, to the nanosecond at any run length
+    out << "{\"traceEvents\": [";
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent& e = events[i];
+        out << (i ? "," : "") << "\n  {";
+        if (e.phase == 'B') out << "\"name\": \"" << e.name << "\", \"cat\": \"mat\", ";
+        out << "\"ph\": \"" << e.phase << "\", \"ts\": " << e.micros << ", \"pid\": 1, \"tid\": " << e.thread;
+        if (e.phase == 'B') {
+            out << ", \"args\": {\"n\": " << e.n;
+            if (e.part >= 0) out << ", \"part\": " << e.part;
+            out << "}";
+        }
+        out << "}";
+    }
+    out << (events.empty() ? "]}" : "\n]}");
+    return out.str();
+}
+
+// Save the trace for the viewer
+void writeTrace(const std::string& path) {
+    std::ofstream file(path.c_str());
+    if (!file) throw std::runtime_error("Cannot open " + path);
+    file << traceJson() << "\n";
+    if (!file) throw std::runtime_error("Cannot write " + path);
+}
+
+// Begin event of the calling thread
+void traceBegin(const char* name, int n, long part) {
+    record(name, 'B', n, part);
+}
+
+// End event: closes the thread's innermost open begin
+void traceEnd() {
+    record(nullptr, 'E', 0, -1);
+}
+
+// Begin if tracing is on
+TraceScope::TraceScope(const char* name, int n, long part) : active(tracingEnabled()) {
+    if (active) traceBegin(name, n, part);
+}
+
+// End what the constructor began, even if tracing was turned off meanwhile
+TraceScope::~TraceScope() {
+    if (active) traceEnd();
+}
+
+} // namespace mat
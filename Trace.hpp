@@ -0,0 +1,40 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include <string>
+
+namespace mat {
+
+// Event tracing in Chrome trace format (chrome://tracing, Perfetto). Off
+// unless SQUAREMAT_TRACE=1 or setTracing(true). Every operator with an
+// OpScope records a begin/end pair, and the kernels add child events for
+// their parallel pieces (GEMM row chunks, matrix tiles, power steps,
+// cofactor tasks, chain products).
+bool tracingEnabled();
+void setTracing(bool on);
+void clearTrace();              // drop recorded events
+
+// Recorded events as {"traceEvents": [...]}; each begin carries the matrix
+// size "n" and, for child events, the piece index "part"
+std::string traceJson();
+void writeTrace(const std::string& path);   // throws runtime_error if the file cannot be written
+
+// Raw events of the calling thread; prefer TraceScope
+void traceBegin(const char* name, int n, long part);
+void traceEnd();
+
+// TraceScope: begin event on construction, end event on destruction.
+// name must outlive the trace (a string literal).
+class TraceScope {
+private:
+    bool active;
+
+public:
+    TraceScope(const char* name, int n, long part = -1);
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    ~TraceScope();
+};
+
+} // namespace mat
@@ -0,0 +1,115 @@
+// avrahamavitan@gmail.com
+#include "Tropical.hpp"
+#include "Parallel.hpp"
+#include <limits>
+
+namespace mat {
+
+static const int K_BLOCK = 128;   // rows of b kept hot per pass
+static const int J_BLOCK = 512;   // columns of the output row kept in L1
+static const int ROW_GRAIN = 16;  // output rows per thread
+
+// Min-plus selection
+struct MinOp {
+    static double zero() { return std::numeric_limits<double>::infinity(); }
+    static double pick(double x, double y) { return y < x ? y : x; }
+};
+
+// Max-plus selection
+struct MaxOp {
+    static double zero() { return -std::numeric_limits<double>::infinity(); }
+    static double pick(double x, double y) { return y > x ? y : x; }
+};
+
+// Blocked i-k-j kernel: the inner j loop is a branch-free min/max over
+// contiguous rows, which the compiler turns into packed SIMD instructions
+template <class Op>
+static SquareMat tropicalProduct(const SquareMat& a, const SquareMat& b) {
+    if (a.dim() != b.dim()) throw std::invalid_argument("Size mismatch");
+    int n = a.dim();
+    SquareMat c(n);
+    double* out = KernelAccess::values(c); // fetched once: workers never touch c itself
+    const double** bRows = new const double*[n];
+    for (int k = 0; k < n; ++k) bRows[k] = b[k];
+    try {
+        parallelFor(0, n, ROW_GRAIN, [&](int lo, int hi) {
+            for (int i = lo; i < hi; ++i) {
+                const double* ai = a[i];
+                double* ci = out + static_cast<size_t>(i) * n;
+                for (int j = 0; j < n; ++j) ci[j] = Op::zero();
+                for (int k0 = 0; k0 < n; k0 += K_BLOCK) {
+                    int k1 = (k0 + K_BLOCK < n) ? k0 + K_BLOCK : n;
+                    for (int j0 = 0; j0 < n; j0 += J_BLOCK) {
+                        int j1 = (j0 + J_BLOCK < n) ? j0 + J_BLOCK : n;
+                        for (int k = k0; k < k1; ++k) {
+                            double aik = ai[k];
+                            if (aik == Op::zero()) continue; // no edge
+                            const double* bk = bRows[k];
+                            for (int j = j0; j < j1; ++j)
+                                ci[j] = Op::pick(ci[j], aik + bk[j]);
+                        }
+                    }
+                }
+            }
+        });
+    } catch (...) {
+        delete[] bRows;
+        throw;
+    }
+    delete[] bRows;
+    return c;
+}
+
+// Tropical power by repeated squaring; the identity has 0 on the diagonal
+template <class Op>
+static SquareMat tropicalPower(const SquareMat& a, int power) {
+    if (power < 0) throw std::invalid_argument("Negative powers not supported");
+    int n = a.dim();
+    SquareMat result(n);
+    double* out = KernelAccess::values(result);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            out[static_cast<size_t>(i) * n + j] = (i == j) ? 0 : Op::zero();
+    SquareMat base(a);
+    while (power) {
+        if (power % 2) result = tropicalProduct<Op>(result, base);
+        power /= 2;
+        if (power) base = tropicalProduct<Op>(base, base);
+    }
+    return result;
+}
+
+// Min-plus product
+SquareMat minPlus(const SquareMat& a, const SquareMat& b) {
+    return tropicalProduct<MinOp>(a, b);
+}
+
+// Max-plus product
+SquareMat maxPlus(const SquareMat& a, const SquareMat& b) {
+    return tropicalProduct<MaxOp>(a, b);
+}
+
+// Min-plus power
+SquareMat minPlusPower(const SquareMat& a, int power) {
+    return tropicalPower<MinOp>(a, power);
+}
+
+// Max-plus power
+SquareMat maxPlusPower(const SquareMat& a, int power) {
+    return tropicalPower<MaxOp>(a, power);
+}
+
+// All-pairs shortest paths: with a zero diagonal, squaring doubles the number
+// of allowed steps, so ceil(log2(n-1)) squarings cover every simple path
+SquareMat shortestPaths(const SquareMat& weights) {
+    int n = weights.dim();
+    SquareMat d(weights);
+    double* dv = KernelAccess::values(d);
+    for (int i = 0; i < n; ++i)
+        if (dv[static_cast<size_t>(i) * n + i] > 0) dv[static_cast<size_t>(i) * n + i] = 0; // staying put is free
+    for (int steps = 1; steps < n - 1; steps *= 2)
+        d = tropicalProduct<MinOp>(d, d);
+    return d;
+}
+
+} // namespace mat
@@ -0,0 +1,17 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+
+namespace mat {
+
+// Tropical semiring products: "addition" is min (or max) and "multiplication" is +.
+// Missing edges are +infinity for min-plus and -infinity for max-plus.
+SquareMat minPlus(const SquareMat& a, const SquareMat& b);   // c[i][j] = min_k a[i][k] + b[k][j]
+SquareMat maxPlus(const SquareMat& a, const SquareMat& b);   // c[i][j] = max_k a[i][k] + b[k][j]
+SquareMat minPlusPower(const SquareMat& a, int power);       // cheapest paths of exactly power steps
+SquareMat maxPlusPower(const SquareMat& a, int power);       // heaviest paths of exactly power steps
+SquareMat shortestPaths(const SquareMat& weights);           // all-pairs shortest paths by repeated squaring
+
+} // namespace mat
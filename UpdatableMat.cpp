@@ -0,0 +1,118 @@
+// avrahamavitan@gmail.com
+#include "UpdatableMat.hpp"
+#include "LU.hpp"
+#include <cmath>
+
+using namespace mat;
+
+// An update counts as singular when |1 + v^T A^-1 u| is below this fraction of
+// 1 + |v^T A^-1 u|: the result would be lost in rounding of the terms
+static const double SINGULAR_TOL = 1e-12;
+
+// Build from a nonsingular matrix
+UpdatableMat::UpdatableMat(const SquareMat& mat, int refactorEvery)
+    : a(mat), inv(mat.dim()), logAbsDet(0), detSign(1), refactorEvery(refactorEvery), pending(0) {
+    if (refactorEvery <= 0) throw std::invalid_argument("Invalid refactor interval");
+    refactor();
+}
+
+// Full O(n^3) refactorization
+void UpdatableMat::refactor() {
+    install(a);
+}
+
+// Make mat the current matrix with a fresh LU inverse and determinant; if
+// the factorization throws, nothing has changed
+void UpdatableMat::install(const SquareMat& mat) {
+    LU lu(mat);
+    SquareMat nextInv = lu.inverse(); // throws if singular
+    int sign;
+    double logDet = lu.slogdet(sign);
+    a = mat;
+    inv = nextInv;
+    logAbsDet = logDet;
+    detSign = sign;
+    pending = 0;
+}
+
+// Rank-1 update in O(n^2):
+//   det(A + u v^T) = det(A) * (1 + v^T A^-1 u)
+//   (A + u v^T)^-1 = A^-1 - (A^-1 u)(v^T A^-1) / (1 + v^T A^-1 u)
+void UpdatableMat::update(const double* u, const double* v) {
+    int n = a.dim();
+    double* w = new double[n]; // A^-1 u
+    double* z = new double[n]; // v^T A^-1
+    const SquareMat& invRead = inv;
+    for (int i = 0; i < n; ++i) {
+        const double* row = invRead[i];
+        double sum = 0;
+        for (int j = 0; j < n; ++j) sum += row[j] * u[j];
+        w[i] = sum;
+        z[i] = 0;
+    }
+    for (int i = 0; i < n; ++i) {
+        const double* row = invRead[i];
+        for (int j = 0; j < n; ++j) z[j] += v[i] * row[j];
+    }
+    double vw = 0; // v^T A^-1 u
+    for (int i = 0; i < n; ++i) vw += v[i] * w[i];
+    double denom = 1 + vw;
+    if (std::fabs(denom) < SINGULAR_TOL * (1 + std::fabs(vw))) {
+        delete[] w;
+        delete[] z;
+        throw std::runtime_error("Update makes matrix singular"); // state unchanged
+    }
+    if (pending + 1 >= refactorEvery) {
+        // due for a refactorization: build the updated matrix aside and factor
+        // it, so a failure leaves matrix, inverse and determinant as they were
+        delete[] w;
+        delete[] z;
+        SquareMat next(n);
+        const SquareMat& aRead = a;
+        double* nextValues = KernelAccess::values(next);
+        for (int i = 0; i < n; ++i) {
+            const double* aRow = aRead[i];
+            double* nextRow = nextValues + static_cast<size_t>(i) * n;
+            for (int j = 0; j < n; ++j) nextRow[j] = aRow[j] + u[i] * v[j];
+        }
+        install(next); // bound the accumulated error
+        return;
+    }
+    double* invValues = KernelAccess::values(inv); // members stay shareable for matrix() and inverse()
+    double* aValues = KernelAccess::values(a);
+    for (int i = 0; i < n; ++i) {
+        double* invRow = invValues + static_cast<size_t>(i) * n;
+        double* aRow = aValues + static_cast<size_t>(i) * n;
+        double wi = w[i] / denom;
+        for (int j = 0; j < n; ++j) {
+            invRow[j] -= wi * z[j];
+            aRow[j] += u[i] * v[j];
+        }
+    }
+    delete[] w;
+    delete[] z;
+    logAbsDet += std::log(std::fabs(denom));
+    if (denom < 0) detSign = -detSign;
+    ++pending;
+}
+
+// Current matrix
+const SquareMat& UpdatableMat::matrix() const {
+    return a;
+}
+
+// Current inverse
+const SquareMat& UpdatableMat::inverse() const {
+    return inv;
+}
+
+// Current determinant
+double UpdatableMat::determinant() const {
+    return detSign * std::exp(logAbsDet);
+}
+
+// Sign and log-magnitude of the current determinant
+double UpdatableMat::slogdet(int& sign) const {
+    sign = detSign;
+    return logAbsDet;
+}
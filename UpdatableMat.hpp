@@ -0,0 +1,38 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+
+namespace mat {
+
+// UpdatableMat: matrix that changes by rank-1 updates A += u * v^T while keeping
+// its inverse (Sherman-Morrison) and determinant (matrix determinant lemma)
+// current in O(n^2) per update. Refactors from scratch every few updates to
+// stop rounding error from building up.
+class UpdatableMat {
+private:
+    SquareMat a;         // current matrix
+    SquareMat inv;       // current inverse
+    double logAbsDet;    // log|det(a)|
+    int detSign;         // sign of det(a)
+    int refactorEvery;   // updates between full refactorizations
+    int pending;         // updates since last refactorization
+
+    void install(const SquareMat& mat);   // adopt mat with a fresh factorization
+
+public:
+    explicit UpdatableMat(const SquareMat& mat, int refactorEvery = 64); // throws if singular
+
+    // A += u * v^T; throws runtime_error, leaving the state unchanged, if the
+    // result is singular to working precision
+    void update(const double* u, const double* v);
+    void refactor();                               // recompute inverse and determinant with LU
+
+    const SquareMat& matrix() const;
+    const SquareMat& inverse() const;
+    double determinant() const;
+    double slogdet(int& sign) const;               // log|det|, sign set to -1 or +1
+};
+
+} // namespace mat
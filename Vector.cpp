@@ -0,0 +1,161 @@
+// avrahamavitan@gmail.com
+#include "Vector.hpp"
+#include "Parallel.hpp"
+
+namespace mat {
+
+static const int ROW_GRAIN = 64;   // matrix rows per thread
+static const int COL_GRAIN = 256;  // output columns per thread for x^T * A
+
+// Dot product with four independent sums so the loop vectorizes
+static double dotKernel(const double* a, const double* b, int n) {
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        s0 += a[j] * b[j];
+        s1 += a[j+1] * b[j+1];
+        s2 += a[j+2] * b[j+2];
+        s3 += a[j+3] * b[j+3];
+    }
+    for (; j < n; ++j) s0 += a[j] * b[j];
+    return (s0 + s1) + (s2 + s3);
+}
+
+// Constructor: create vector of n zeros
+Vector::Vector(int n) : size(n) {
+    if (n <= 0) throw std::invalid_argument("Invalid vector size");
+    data = new double[size]();
+}
+
+// Copy entries from other vector
+void Vector::copy(const Vector& other) {
+    size = other.size;
+    data = new double[size];
+    for (int i = 0; i < size; ++i) data[i] = other.data[i];
+}
+
+// Copy constructor
+Vector::Vector(const Vector& other) {
+    copy(other);
+}
+
+// Assignment operator: clean old data and copy new data
+Vector& Vector::operator=(const Vector& other) {
+    if (this != &other) {
+        delete[] data;
+        copy(other);
+    }
+    return *this;
+}
+
+// Destructor: free memory
+Vector::~Vector() {
+    delete[] data;
+}
+
+// Number of entries
+int Vector::dim() const {
+    return size;
+}
+
+// Access entry by index (non-const)
+double& Vector::operator[](int index) {
+    if (index < 0 || index >= size) throw std::out_of_range("Index out of range");
+    return data[index];
+}
+
+// Access entry by index (const version)
+double Vector::operator[](int index) const {
+    if (index < 0 || index >= size) throw std::out_of_range("Index out of range");
+    return data[index];
+}
+
+// Pointer to the entries (non-const)
+double* Vector::raw() {
+    return data;
+}
+
+// Pointer to the entries (const version)
+const double* Vector::raw() const {
+    return data;
+}
+
+// Add two vectors
+Vector Vector::operator+(const Vector& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    Vector result(size);
+    for (int i = 0; i < size; ++i) result.data[i] = data[i] + other.data[i];
+    return result;
+}
+
+// Subtract two vectors
+Vector Vector::operator-(const Vector& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    Vector result(size);
+    for (int i = 0; i < size; ++i) result.data[i] = data[i] - other.data[i];
+    return result;
+}
+
+// Multiply each entry by scalar
+Vector Vector::operator*(double scalar) const {
+    Vector result(size);
+    for (int i = 0; i < size; ++i) result.data[i] = data[i] * scalar;
+    return result;
+}
+
+// Dot product
+double Vector::dot(const Vector& other) const {
+    if (size != other.size) throw std::invalid_argument("Size mismatch");
+    return dotKernel(data, other.data, size);
+}
+
+// A * x: one dot product per row, rows split across threads
+Vector operator*(const SquareMat& a, const Vector& x) {
+    int n = a.dim();
+    if (x.size != n) throw std::invalid_argument("Size mismatch");
+    Vector y(n);
+    parallelFor(0, n, ROW_GRAIN, [&](int lo, int hi) {
+        for (int i = lo; i < hi; ++i)
+            y.data[i] = dotKernel(a[i], x.data, n);
+    });
+    return y;
+}
+
+// x^T * A: accumulate x[i] * row i, each thread owning a band of columns
+Vector operator*(const Vector& x, const SquareMat& a) {
+    int n = a.dim();
+    if (x.size != n) throw std::invalid_argument("Size mismatch");
+    Vector y(n);
+    parallelFor(0, n, COL_GRAIN, [&](int lo, int hi) {
+        double* out = y.data;
+        for (int i = 0; i < n; ++i) {
+            double xi = x.data[i]; // zeros are not skipped: 0 * Inf and 0 * NaN give NaN
+            const double* row = a[i];
+            for (int j = lo; j < hi; ++j) out[j] += xi * row[j];
+        }
+    });
+    return y;
+}
+
+// Batched A * x: each row of A is loaded once and used for every vector
+void gemvBatch(const SquareMat& a, const Vector* xs, Vector* ys, int count) {
+    int n = a.dim();
+    for (int v = 0; v < count; ++v)
+        if (xs[v].size != n || ys[v].size != n) throw std::invalid_argument("Size mismatch");
+    parallelFor(0, n, ROW_GRAIN, [&](int lo, int hi) {
+        for (int i = lo; i < hi; ++i) {
+            const double* row = a[i];
+            for (int v = 0; v < count; ++v)
+                ys[v].data[i] = dotKernel(row, xs[v].data, n);
+        }
+    });
+}
+
+// Output vector to stream
+std::ostream& operator<<(std::ostream& os, const Vector& v) {
+    for (int i = 0; i < v.size; ++i) os << v.data[i] << ' ';
+    os << '\n';
+    return os;
+}
+
+} // namespace mat
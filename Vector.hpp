@@ -0,0 +1,45 @@
+//avrahamavitan@gmail.com
+
+#pragma once
+
+#include "SquareMat.hpp"
+
+namespace mat {
+
+// Vector: dense vector of doubles, for matrix-vector products and solves
+class Vector {
+private:
+    int size;        // number of entries
+    double* data;    // entries
+
+    void copy(const Vector& other);
+
+public:
+    explicit Vector(int size);            // create zero vector (no implicit int -> Vector)
+    Vector(const Vector& other);          // copy constructor
+    Vector& operator=(const Vector& other);
+    ~Vector();                            // destructor
+
+    int dim() const;                      // number of entries
+    double& operator[](int index);        // access entry
+    double operator[](int index) const;
+    double* raw();                        // contiguous entries, for kernels
+    const double* raw() const;
+
+    Vector operator+(const Vector& other) const;
+    Vector operator-(const Vector& other) const;
+    Vector operator*(double scalar) const;
+    double dot(const Vector& other) const;
+
+    friend Vector operator*(const SquareMat& a, const Vector& x);   // A * x
+    friend Vector operator*(const Vector& x, const SquareMat& a);   // x^T * A
+    friend void gemvBatch(const SquareMat& a, const Vector* xs, Vector* ys, int count);
+    friend std::ostream& operator<<(std::ostream& os, const Vector& v);
+};
+
+Vector operator*(const SquareMat& a, const Vector& x);   // A * x
+Vector operator*(const Vector& x, const SquareMat& a);   // x^T * A
+// ys[v] = A * xs[v] for count vectors, reading A only once (ys must not alias xs)
+void gemvBatch(const SquareMat& a, const Vector* xs, Vector* ys, int count);
+
+} // namespace mat
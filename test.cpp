@@ -2,7 +2,35 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "SquareMat.hpp"
+#include "LU.hpp"
+#include "Cholesky.hpp"
+#include "UpdatableMat.hpp"
+#include "BoolMat.hpp"
+#include "Tropical.hpp"
+#include "Vector.hpp"
+#include "PackedMat.hpp"
+#include "BandMat.hpp"
+#include "TiledMat.hpp"
+#include "DiskMat.hpp"
+#include "MatView.hpp"
+#include "Async.hpp"
+#include "Parallel.hpp"
+#include "Lazy.hpp"
+#include "Chain.hpp"
+#include "Numa.hpp"
+#include "Alloc.hpp"
+#include "Profile.hpp"
+#include "Trace.hpp"
 #include <sstream>
+#include <thread>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+#include <unistd.h>
 using namespace mat; // assuming the SquareMat class is in namespace mat
 // Test that valid operations work without errors
 TEST_CASE("Valid operations do not throw") {
@@ -140,3 +168,1211 @@ TEST_CASE("Bulk operator tests") {
         }
     }
 }
+
+// Test that the eigendecomposition power path matches repeated squaring
+TEST_CASE("Symmetric eigen power") {
+    SquareMat s(3);
+    s[0][0] = 2; s[0][1] = -1; s[0][2] = 0;
+    s[1][0] = -1; s[1][1] = 2; s[1][2] = -1;
+    s[2][0] = 0; s[2][1] = -1; s[2][2] = 2;
+    CHECK(s.isSymmetric());
+
+    double values[3];
+    SquareMat v(3);
+    s.symmetricEigen(values, v);
+    for (int k = 0; k < 3; ++k) // check A * v_k == lambda_k * v_k
+        for (int i = 0; i < 3; ++i) {
+            double av = 0;
+            for (int j = 0; j < 3; ++j) av += s[i][j] * v[j][k];
+            CHECK(av == doctest::Approx(values[k] * v[i][k]));
+        }
+
+    SquareMat p1 = s ^ 7;             // repeated squaring
+    SquareMat p2 = s.symmetricPower(7); // eigen path
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            CHECK(p2[i][j] == doctest::Approx(p1[i][j]));
+
+    // large power of a symmetric Markov chain converges to the uniform matrix
+    SquareMat chain(2);
+    chain[0][0] = 0.9; chain[0][1] = 0.1;
+    chain[1][0] = 0.1; chain[1][1] = 0.9;
+    SquareMat limit = chain.symmetricPower(1000000);
+    CHECK(limit[0][0] == doctest::Approx(0.5));
+    CHECK(limit[1][0] == doctest::Approx(0.5));
+
+    SquareMat swap(2); // ^ never switches to the eigen path on its own
+    swap[0][1] = 1;
+    swap[1][0] = 1;
+    SquareMat odd = swap ^ 4097;
+    CHECK(odd[0][0] == 0);
+    CHECK(odd[0][1] == 1);
+
+    SquareMat notSym(2);
+    notSym[0][1] = 1;
+    CHECK_FALSE(notSym.isSymmetric());
+    CHECK_THROWS_AS(notSym.symmetricEigen(values, v), std::invalid_argument);
+}
+
+// Test LU solve, inverse and determinant on one factorization
+TEST_CASE("LU factorization") {
+    SquareMat a(3);
+    a[0][0] = 0; a[0][1] = 2; a[0][2] = 1; // zero first pivot forces a row swap
+    a[1][0] = 1; a[1][1] = 1; a[1][2] = 0;
+    a[2][0] = 3; a[2][1] = 0; a[2][2] = 1;
+    LU lu(a);
+    CHECK_FALSE(lu.isSingular());
+    CHECK(lu.determinant() == doctest::Approx(!a));
+
+    double b[3] = {7, 3, 6}, x[3];
+    lu.solve(b, x); // A*x = b with x = (1, 2, 3)
+    CHECK(x[0] == doctest::Approx(1));
+    CHECK(x[1] == doctest::Approx(2));
+    CHECK(x[2] == doctest::Approx(3));
+
+    SquareMat inv = lu.inverse();
+    SquareMat id = a * inv;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            CHECK(id[i][j] == doctest::Approx(i == j ? 1.0 : 0.0));
+
+    SquareMat s(2); // singular matrix
+    s[0][0] = 1; s[0][1] = 2;
+    s[1][0] = 2; s[1][1] = 4;
+    LU ls(s);
+    CHECK(ls.isSingular());
+    CHECK(ls.determinant() == 0);
+    CHECK_THROWS_AS(ls.inverse(), std::runtime_error);
+    CHECK_THROWS_AS(lu.solve(s), std::invalid_argument);
+
+    SquareMat near(3); // third row is the sum of the others, up to rounding
+    double r0[3] = {0.1, 0.2, 0.3}, r1[3] = {0.4, 0.5, 0.6};
+    for (int j = 0; j < 3; ++j) {
+        near[0][j] = r0[j];
+        near[1][j] = r1[j];
+        near[2][j] = r0[j] + r1[j];
+    }
+    LU ln(near);
+    CHECK(ln.isSingular());
+    CHECK_THROWS_AS(ln.inverse(), std::runtime_error);
+    LU copied = ln; // plain value copy
+    CHECK(copied.isSingular());
+}
+
+// Test Cholesky against LU on small and multi-block SPD matrices
+TEST_CASE("Cholesky factorization") {
+    SquareMat a(3);
+    a[0][0] = 4;  a[0][1] = 12;  a[0][2] = -16;
+    a[1][0] = 12; a[1][1] = 37;  a[1][2] = -43;
+    a[2][0] = -16; a[2][1] = -43; a[2][2] = 98;
+    Cholesky ch(a);
+    SquareMat l = ch.factor();
+    CHECK(l[0][0] == doctest::Approx(2));
+    CHECK(l[1][0] == doctest::Approx(6));
+    CHECK(l[2][2] == doctest::Approx(3));
+    CHECK(ch.determinant() == doctest::Approx(36));
+    CHECK(ch.logdet() == doctest::Approx(std::log(36.0)));
+
+    // larger than one block, so the panel and trailing updates run in parallel
+    const int n = 150;
+    SquareMat b(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            b[i][j] = ((i * 7 + j * 13) % 11) / 10.0;
+    SquareMat spd = (b * ~b) / n;
+    for (int i = 0; i < n; ++i) spd[i][i] += 1;
+    Cholesky big(spd);
+    LU lu(spd);
+    CHECK(big.logdet() == doctest::Approx(std::log(std::fabs(lu.determinant()))));
+    SquareMat id = spd * big.inverse();
+    CHECK(id[0][0] == doctest::Approx(1));
+    CHECK(id[n-1][0] == doctest::Approx(0).epsilon(1e-9));
+    double rhs[n], x[n];
+    for (int i = 0; i < n; ++i) rhs[i] = i;
+    big.solve(rhs, x);
+    double r = 0;
+    for (int j = 0; j < n; ++j) r += spd[n-1][j] * x[j];
+    CHECK(r == doctest::Approx(n-1));
+
+    SquareMat indefinite(2); // symmetric but not positive definite
+    indefinite[0][0] = 1; indefinite[0][1] = 2;
+    indefinite[1][0] = 2; indefinite[1][1] = 1;
+    CHECK_THROWS_WITH_AS(Cholesky c(indefinite), "Matrix is not positive definite", std::invalid_argument);
+    SquareMat nonSym(2);
+    nonSym[0][0] = 1; nonSym[0][1] = 1; nonSym[1][1] = 1;
+    CHECK_THROWS_WITH_AS(Cholesky c(nonSym), "Matrix is not symmetric", std::invalid_argument);
+    SquareMat rounded(2); // off by one ulp, as a computed B * B^T can be
+    rounded[0][0] = 4; rounded[1][1] = 3;
+    rounded[0][1] = 0.1 + 0.2;
+    rounded[1][0] = 0.3;
+    CHECK_FALSE(rounded.isSymmetric());
+    CHECK(Cholesky(rounded).factor()[1][0] == doctest::Approx(0.15));
+    CHECK(rounded.isNearlySymmetric());
+    CHECK(SymMat(rounded).get(0, 1) == rounded[1][0]); // packed from the lower triangle
+    CHECK_THROWS_AS(SymMat{nonSym}, std::invalid_argument);
+}
+
+// Test log-determinant where the plain determinant overflows
+TEST_CASE("Log-determinant without overflow") {
+    const int n = 400;
+    SquareMat big(n);
+    for (int i = 0; i < n; ++i) big[i][i] = 10; // det = 10^400 overflows a double
+    big[0][0] = -10;
+    int sign = 0;
+    CHECK(big.slogdet(sign) == doctest::Approx(n * std::log(10.0)));
+    CHECK(sign == -1);
+    CHECK(std::isnan(big.logdet()));
+
+    SquareMat tiny(n);
+    for (int i = 0; i < n; ++i) tiny[i][i] = 0.1; // det = 10^-400 underflows
+    CHECK(tiny.logdet() == doctest::Approx(-n * std::log(10.0)));
+
+    SquareMat a(2);
+    a[0][0] = 1; a[0][1] = 2;
+    a[1][0] = 3; a[1][1] = 4;
+    CHECK(a.slogdet(sign) == doctest::Approx(std::log(2.0)));
+    CHECK(sign == -1);
+
+    SquareMat zero(3);
+    CHECK(zero.slogdet(sign) == -INFINITY);
+    CHECK(sign == 0);
+}
+
+// Test exact integer determinant (Bareiss)
+TEST_CASE("Exact integer determinant") {
+    SquareMat a(3);
+    a[0][0] = 0; a[0][1] = 2; a[0][2] = 1; // zero pivot forces a row swap
+    a[1][0] = 1; a[1][1] = 1; a[1][2] = 0;
+    a[2][0] = 3; a[2][1] = 0; a[2][2] = 1;
+    CHECK(a.exactDeterminant() == -5);
+    CHECK(a.exactDeterminant() == static_cast<long long>(!a));
+
+    // product of unit triangular matrices has det 1 but large entries
+    const int n = 25;
+    SquareMat lower(n), upper(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j <= i; ++j) {
+            lower[i][j] = 1;
+            upper[j][i] = 1;
+        }
+    CHECK((lower * upper).exactDeterminant() == 1);
+
+    SquareMat big(2); // 3e9 * 3e9 needs more than 64 bits in the intermediate
+    big[0][0] = 3000000000.0; big[0][1] = 2999999999.0;
+    big[1][0] = 3000000001.0; big[1][1] = 3000000000.0;
+    CHECK(big.exactDeterminant() == 1);
+
+    SquareMat singular(3);
+    singular[0][0] = 1; singular[1][0] = 2; singular[2][0] = 3;
+    CHECK(singular.exactDeterminant() == 0);
+
+    SquareMat frac(2);
+    frac[0][0] = 0.5;
+    CHECK_THROWS_AS(frac.exactDeterminant(), std::invalid_argument);
+
+    SquareMat huge(3); // 9e18 * 8.1e37 overflows the 128-bit intermediate
+    for (int i = 0; i < 3; ++i) huge[i][i] = 9e18;
+    CHECK_THROWS_AS(huge.exactDeterminant(), std::overflow_error);
+}
+
+// Test rank-1 updates against recomputing from scratch
+TEST_CASE("Rank-1 updates of inverse and determinant") {
+    const int n = 4;
+    SquareMat a(n);
+    for (int i = 0; i < n; ++i) {
+        a[i][i] = 3;
+        if (i + 1 < n) a[i][i+1] = 1;
+    }
+    UpdatableMat m(a, 3); // refactor every 3 updates
+    CHECK(m.determinant() == doctest::Approx(81));
+
+    for (int step = 0; step < 5; ++step) {
+        double u[n], v[n];
+        for (int i = 0; i < n; ++i) {
+            u[i] = (i + step) % 3 - 1;
+            v[i] = 0.25 * ((i * step) % 2);
+        }
+        m.update(u, v);
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                a[i][j] += u[i] * v[j];
+        LU lu(a);
+        CHECK(m.determinant() == doctest::Approx(lu.determinant()));
+        SquareMat inv = lu.inverse();
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                CHECK(m.inverse()[i][j] == doctest::Approx(inv[i][j]));
+    }
+
+    SquareMat id(2); // update that would make the matrix singular
+    id[0][0] = 1; id[1][1] = 1;
+    UpdatableMat s(id);
+    double u[2] = {-1, 0}, v[2] = {1, 0};
+    CHECK_THROWS_AS(s.update(u, v), std::runtime_error);
+    CHECK(s.determinant() == doctest::Approx(1)); // unchanged
+    double nearly[2] = {-(1 - 1e-15), 0}; // singular up to rounding
+    CHECK_THROWS_AS(s.update(nearly, v), std::runtime_error);
+    UpdatableMat every(id, 1); // refactors on every update
+    CHECK_THROWS_AS(every.update(nearly, v), std::runtime_error);
+    CHECK(every.determinant() == doctest::Approx(1));
+    CHECK(every.inverse()[0][0] == doctest::Approx(1));
+    CHECK(every.matrix()[0][0] == 1);
+
+    SquareMat zero(2);
+    CHECK_THROWS_AS(UpdatableMat z(zero), std::runtime_error);
+}
+
+// Test bit-packed boolean products against SquareMat products
+TEST_CASE("Boolean matrix reachability") {
+    const int n = 70; // more than one word per row
+    SquareMat g(n);
+    for (int i = 0; i + 1 < n; ++i) g[i][i+1] = 1; // path 0 -> 1 -> ... -> n-1
+    g[n-1][n-2] = 1;
+    BoolMat b(g);
+    CHECK(b.count() == n);
+    CHECK(b.get(0, 1));
+    CHECK_FALSE(b.get(1, 0));
+
+    SquareMat p3 = g ^ 3;
+    BoolMat b3 = b ^ 3;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            CHECK(b3.get(i, j) == (p3[i][j] != 0));
+    CHECK(BoolMat(g * g) == b * b);
+
+    BoolMat reach = b.closure();
+    CHECK(reach.get(0, n-1));
+    CHECK_FALSE(reach.get(1, 0));
+    CHECK(reach.get(n-1, n-1)); // n-1 -> n-2 -> n-1
+    CHECK(reach.count() == (long long)n * (n - 1) / 2 + 3); // plus (n-1, n-2) and two self-loops
+    CHECK(reach.toSquareMat()[0][n-1] == 1);
+
+    b.set(n-1, 0, true); // close the cycle: everything reaches everything
+    CHECK(b.closure().count() == (long long)n * n);
+    CHECK_THROWS_AS(b.get(n, 0), std::out_of_range);
+    CHECK_THROWS_AS(b * BoolMat(2), std::invalid_argument);
+}
+
+// Test min-plus and max-plus products and all-pairs shortest paths
+TEST_CASE("Tropical semiring products") {
+    const double inf = INFINITY;
+    SquareMat w(4); // directed graph 0 -> 1 -> 2 -> 3 plus a costly shortcut 0 -> 3
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            w[i][j] = inf;
+    w[0][1] = 1; w[1][2] = 2; w[2][3] = 3; w[0][3] = 10;
+
+    SquareMat two = minPlus(w, w);
+    CHECK(two[0][2] == 3);
+    CHECK(two[0][3] == inf); // no 2-step path reaches 3 from 0
+    CHECK(minPlusPower(w, 3)[0][3] == 6);
+    CHECK(minPlusPower(w, 0)[2][2] == 0);
+
+    SquareMat d = shortestPaths(w);
+    CHECK(d[0][3] == 6); // 1 + 2 + 3 beats 10
+    CHECK(d[1][3] == 5);
+    CHECK(d[3][0] == inf);
+    CHECK(d[2][2] == 0);
+
+    SquareMat g(2); // max-plus: longest 2-step walk
+    g[0][0] = 1; g[0][1] = 5;
+    g[1][0] = 2; g[1][1] = -INFINITY;
+    SquareMat m = maxPlus(g, g);
+    CHECK(m[0][0] == 7); // 0 -> 1 -> 0
+    CHECK(m[1][1] == 7); // 1 -> 0 -> 1
+    CHECK(maxPlusPower(g, 2) == m);
+    CHECK_THROWS_AS(minPlus(w, g), std::invalid_argument);
+    CHECK_THROWS_AS(minPlusPower(w, -1), std::invalid_argument);
+}
+
+// Test matrix-vector products against SquareMat products
+TEST_CASE("Matrix-vector products") {
+    const int n = 5;
+    SquareMat a(n);
+    Vector x(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = i + 1;
+        for (int j = 0; j < n; ++j) a[i][j] = (i * 3 + j) % 7 - 3;
+    }
+    SquareMat col(n); // x stored as the first column of a matrix
+    for (int i = 0; i < n; ++i) col[i][0] = x[i];
+    SquareMat ax = a * col;
+    SquareMat xa = ~col * a;
+
+    Vector y = a * x;
+    Vector z = x * a;
+    for (int i = 0; i < n; ++i) {
+        CHECK(y[i] == ax[i][0]);
+        CHECK(z[i] == xa[0][i]);
+    }
+    CHECK(x.dot(x) == 55);
+
+    Vector xs[2] = {x, x * 2};
+    Vector ys[2] = {Vector(n), Vector(n)};
+    gemvBatch(a, xs, ys, 2);
+    for (int i = 0; i < n; ++i) {
+        CHECK(ys[0][i] == y[i]);
+        CHECK(ys[1][i] == 2 * y[i]);
+    }
+
+    SquareMat spd(n); // solve through LU and Cholesky
+    for (int i = 0; i < n; ++i) spd[i][i] = 2;
+    Vector b = spd * x;
+    CHECK(LU(spd).solve(b)[n-1] == doctest::Approx(x[n-1]));
+    CHECK(Cholesky(spd).solve(b)[0] == doctest::Approx(x[0]));
+
+    CHECK_THROWS_AS(a * Vector(2), std::invalid_argument);
+    CHECK_THROWS_AS(x[n], std::out_of_range);
+    CHECK_THROWS_AS(Vector(0), std::invalid_argument);
+    static_assert(!std::is_convertible<int, Vector>::value, "a size must not turn into a vector");
+}
+
+// Test fused multiply-accumulate with every transpose combination
+TEST_CASE("Fused gemm") {
+    SquareMat a(3), b(3);
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j) {
+            a[i][j] = i * 3 + j + 1;
+            b[i][j] = (i + 2 * j) % 4 - 1;
+        }
+    for (int ta = 0; ta < 2; ++ta)
+        for (int tb = 0; tb < 2; ++tb) {
+            SquareMat c(3);
+            for (int i = 0; i < 3; ++i) c[i][i] = 1;
+            SquareMat expected = (ta ? ~a : a) * (tb ? ~b : b) * 0.5 + c * 2;
+            gemm(0.5, a, b, 2.0, c, ta, tb); // c = 0.5 * op(a) * op(b) + 2 * c
+            for (int i = 0; i < 3; ++i)
+                for (int j = 0; j < 3; ++j)
+                    CHECK(c[i][j] == expected[i][j]);
+        }
+
+    SquareMat c(3); // beta = 0 overwrites even NaN contents
+    c[0][0] = NAN;
+    gemm(1.0, a, b, 0.0, c);
+    CHECK(c[0][0] == (a * b)[0][0]);
+
+    CHECK_THROWS_AS(gemm(1.0, a, b, 0.0, a), std::invalid_argument); // aliasing
+    SquareMat small(2);
+    CHECK_THROWS_AS(gemm(1.0, a, b, 0.0, small), std::invalid_argument);
+
+    SquareMat acc(a); // in-place compound operators
+    acc += a;
+    acc -= b;
+    CHECK(acc[1][2] == 2 * a[1][2] - b[1][2]);
+    CHECK_THROWS_AS(acc /= 0, std::invalid_argument);
+}
+
+// Test packed symmetric and triangular products and solves
+TEST_CASE("Packed symmetric and triangular matrices") {
+    const int n = 4;
+    SquareMat full(n), b(n);
+    Vector x(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = i - 1;
+        for (int j = 0; j < n; ++j) {
+            full[i][j] = (i + j) % 5 + (i == j ? 4 : 0);
+            b[i][j] = i * n + j;
+        }
+    }
+    SymMat s(full);
+    CHECK(s.get(1, 3) == full[1][3]);
+    SquareMat sb = s * b;
+    CHECK(sb[3][2] == (full * b)[3][2]);
+    Vector sx = s * x;
+    Vector fx = full * x;
+    for (int i = 0; i < n; ++i) CHECK(sx[i] == fx[i]);
+    s.set(0, 2, 9);
+    CHECK(s.get(2, 0) == 9);
+    SquareMat notSym(n);
+    notSym[0][1] = 1;
+    CHECK_THROWS_AS(SymMat bad(notSym), std::invalid_argument);
+
+    TriMat l(full, true);
+    TriMat u = l.transpose();
+    CHECK_FALSE(u.isLower());
+    CHECK(u.get(1, 3) == full[3][1]);
+    CHECK(u.get(3, 1) == 0);
+    SquareMat lFull = l.toSquareMat();
+    SquareMat lb = l * b;
+    SquareMat ub = u * b;
+    SquareMat expectedL = lFull * b;
+    SquareMat expectedU = ~lFull * b;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            CHECK(lb[i][j] == expectedL[i][j]);
+            CHECK(ub[i][j] == expectedU[i][j]);
+        }
+    CHECK(l.determinant() == doctest::Approx(!lFull));
+
+    Vector y = l * x; // solve back to x, directly and through the transpose flag
+    Vector back = l.solve(y);
+    Vector uy = u * x;
+    Vector backT = l.solve(uy, true);
+    for (int i = 0; i < n; ++i) {
+        CHECK(back[i] == doctest::Approx(x[i]));
+        CHECK(backT[i] == doctest::Approx(x[i]));
+    }
+    SquareMat xs = u.solve(ub);
+    CHECK(xs[2][1] == doctest::Approx(b[2][1]));
+    CHECK_THROWS_AS(l.set(0, 1, 1), std::invalid_argument);
+    CHECK_THROWS_AS(TriMat(n).solve(x), std::runtime_error);
+}
+
+// Test band and diagonal operators against full SquareMat operators
+TEST_CASE("Band and diagonal matrices") {
+    const int n = 6;
+    SquareMat ta(n), tb(n); // tridiagonal and upper bidiagonal
+    for (int i = 0; i < n; ++i) {
+        ta[i][i] = i % 3 - 1; // zero on the diagonal forces pivoting
+        if (i > 0) ta[i][i-1] = 2;
+        if (i + 1 < n) { ta[i][i+1] = i + 1; tb[i][i+1] = -1; }
+        tb[i][i] = 3;
+    }
+    BandMat a(ta, 1, 1), b(tb, 0, 1);
+    SquareMat expected[5] = {ta + tb, ta - tb, ta * tb, ta ^ 3, ~ta};
+    BandMat got[5] = {a + b, a - b, a * b, a ^ 3, ~a};
+    for (int t = 0; t < 5; ++t) {
+        SquareMat g = got[t].toSquareMat();
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                CHECK(g[i][j] == expected[t][i][j]);
+    }
+    CHECK((a * b).lower() == 1);
+    CHECK((a * b).upper() == 2);
+    CHECK((-a).get(1, 0) == -2);
+    CHECK(!a == doctest::Approx(!ta));
+    CHECK(!b == doctest::Approx(729)); // 3^6
+    CHECK(a.get(0, 5) == 0);
+    CHECK_THROWS_AS(a.set(0, 5, 1), std::invalid_argument);
+    CHECK_THROWS_AS(BandMat(n, n, 0), std::invalid_argument);
+
+    DiagMat d(n);
+    for (int i = 0; i < n; ++i) d[i] = i + 1;
+    SquareMat df = d.toSquareMat();
+    CHECK((d ^ 3)[2] == 27);
+    CHECK(!d == 720);
+    CHECK((d * d)[4] == 25);
+    CHECK((d + d - d)[1] == 2);
+    CHECK((~d)[5] == 6);
+    SquareMat db = d * ta;
+    SquareMat expectedDb = df * ta;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            CHECK(db[i][j] == expectedDb[i][j]);
+}
+
+// Test tiled multiply, add and transpose with padded edge tiles
+TEST_CASE("Tiled matrix operations") {
+    const int n = 10;
+    SquareMat a(n), b(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            a[i][j] = (i * 7 + j) % 5 - 2;
+            b[i][j] = (i + j * 3) % 4;
+        }
+    TiledMat ta(a, 4), tb(b, 4); // 3x3 tiles, last row/column of tiles padded
+    CHECK(ta.tileCount() == 3);
+    CHECK(ta.get(9, 2) == a[9][2]);
+
+    SquareMat expected[3] = {a * b, a + b, ~a};
+    TiledMat got[3] = {ta * tb, ta + tb, ~ta};
+    for (int t = 0; t < 3; ++t) {
+        SquareMat g = got[t].toSquareMat();
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                CHECK(g[i][j] == expected[t][i][j]);
+    }
+
+    ta.block(0, 0)[1][1] = 42; // tiles are plain SquareMats
+    CHECK(ta.get(1, 1) == 42);
+    CHECK_THROWS_AS(ta.block(3, 0), std::out_of_range);
+    CHECK_THROWS_AS(ta * TiledMat(a, 5), std::invalid_argument);
+}
+
+// Test the tiled LU against P*A = L*U and the plain LU determinant
+TEST_CASE("Tiled LU factorization") {
+    const int n = 11;
+    SquareMat a(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            a[i][j] = ((i * 7 + j * 3) % 11) - 5 + (i == j ? 0.5 : 0);
+    TiledMat ta(a, 4); // 3x3 tiles, padded edge, pivots cross tile rows
+    std::vector<int> perm;
+    int sign = 0;
+    CHECK(ta.factorLU(perm, sign));
+    SquareMat f = ta.toSquareMat(), l(n), u(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            if (j < i) l[i][j] = f[i][j];
+            else u[i][j] = f[i][j];
+            if (j == i) l[i][j] = 1;
+        }
+    SquareMat product = l * u;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            CHECK(product[i][j] == doctest::Approx(a[perm[i]][j]));
+    CHECK(TiledMat(a, 4).determinant() == doctest::Approx(LU(a).determinant()));
+    CHECK(TiledMat(a, 16).determinant() == doctest::Approx(LU(a).determinant())); // one tile
+
+    SquareMat dependent(a); // last row repeats the first
+    for (int j = 0; j < n; ++j) dependent[n - 1][j] = a[0][j];
+    TiledMat td(dependent, 4);
+    CHECK_FALSE(td.factorLU(perm, sign));
+    CHECK(TiledMat(dependent, 4).determinant() == doctest::Approx(0).epsilon(1e-9));
+}
+
+// Test the memory-mapped matrix and out-of-core multiply
+TEST_CASE("Disk-backed matrix multiply") {
+    const int n = 10;
+    SquareMat a(n), b(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            a[i][j] = (i * 5 + j) % 7 - 3;
+            b[i][j] = (i + 2 * j) % 3;
+        }
+    char dirName[] = "/tmp/squaremat_test_XXXXXX"; // keep the working directory clean
+    REQUIRE(mkdtemp(dirName) != nullptr);
+    std::string dir = dirName;
+    std::string pa = dir + "/a.mat", pb = dir + "/b.mat", pc = dir + "/c.mat";
+    {
+        DiskMat da(pa, n, 4), db(pb, n, 4), dc(pc, n, 4);
+        da.assign(a);
+        db.assign(b);
+        CHECK(da.get(7, 3) == a[7][3]);
+        DiskMat::multiply(da, db, dc);
+        dc.flush();
+        CHECK_THROWS_AS(DiskMat::multiply(da, db, da), std::invalid_argument);
+    }
+    DiskMat reopened(pc); // dimensions come from the file header
+    CHECK(reopened.dim() == n);
+    CHECK(reopened.tileSize() == 4);
+    SquareMat c = reopened.toSquareMat();
+    SquareMat expected = a * b;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            CHECK(c[i][j] == expected[i][j]);
+
+    REQUIRE(truncate(pb.c_str(), 4096 + 100) == 0); // header intact, tiles cut off
+    CHECK_THROWS_AS(DiskMat{pb}, std::runtime_error);
+    int zero = 0; // tile size 0 in an otherwise valid header
+    std::fstream header(pa.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    header.seekp(8 + sizeof(int));
+    header.write(reinterpret_cast<const char*>(&zero), sizeof(zero));
+    header.close();
+    CHECK_THROWS_AS(DiskMat{pa}, std::runtime_error);
+
+    std::remove(pa.c_str());
+    std::remove(pb.c_str());
+    std::remove(pc.c_str());
+    rmdir(dir.c_str());
+    CHECK_THROWS_AS(DiskMat(dir + "/no_such_dir/x.mat", n), std::runtime_error);
+}
+
+// Test copy-on-write sharing of matrix values
+TEST_CASE("Copy-on-write storage") {
+    SquareMat filled(3);
+    filled[0][0] = 1; filled[1][1] = 2;
+    SquareMat a = filled;                // deep copy (filled leaked), a itself did not
+    const SquareMat& ca = a;             // const reads keep sharing
+    const SquareMat b(a); // O(1) copy
+    SquareMat c = a;
+    CHECK(b.sharesWith(a));
+    CHECK(c.sharesWith(a));
+    CHECK(b[1][1] == 2);
+    CHECK(b.sharesWith(a));
+    CHECK_FALSE(SquareMat(filled).sharesWith(filled)); // filled handed out row pointers
+
+    SquareMat product = filled * filled; // kernels write results without leaking them
+    CHECK(SquareMat(product).sharesWith(product));
+    SquareMat power = filled ^ 5;
+    CHECK(SquareMat(power).sharesWith(power));
+    const SquareMat& cpower = power;
+    CHECK(cpower[1][1] == 32);
+    SquareMat tiled = TiledMat(filled, 2).toSquareMat();
+    CHECK(SquareMat(tiled).sharesWith(tiled));
+
+    c[0][0] = 5; // first write through operator[] makes c private
+    CHECK_FALSE(c.sharesWith(a));
+    CHECK(ca[0][0] == 1);
+    CHECK(b[0][0] == 1);
+
+    SquareMat d(a);
+    ++d;
+    CHECK_FALSE(d.sharesWith(a));
+    CHECK(d[2][2] == 1);
+    CHECK(b[2][2] == 0);
+
+    SquareMat e(a);
+    e += a; // compound operators detach too
+    CHECK(e[1][1] == 4);
+    CHECK(b[1][1] == 2);
+
+    SquareMat f(a);
+    gemm(1.0, b, b, 0.0, f); // output shared with the inputs
+    CHECK(f[1][1] == 4);
+    CHECK(b[1][1] == 2);
+
+    SquareMat g(2);
+    {
+        SquareMat tmp(2);
+        tmp[0][1] = 7;
+        g = tmp;
+    } // tmp gone, g keeps the values
+    CHECK(g[0][1] == 7);
+
+    // a row pointer or view taken before a copy must not write into the copy
+    SquareMat s = a;
+    double* r = s[0];
+    SquareMat t = s;
+    r[0] = 5;
+    const SquareMat& ct = t;
+    CHECK(ct[0][0] == 1);
+    CHECK_FALSE(t.sharesWith(s));
+    MatView v(s);
+    SquareMat u = s;
+    v[1][1] = 9;
+    const SquareMat& cu = u;
+    CHECK(cu[1][1] == 2);
+    CHECK(SquareMat(u).sharesWith(u)); // u itself never leaked
+    s = a; // a new value: shareable again
+    CHECK(SquareMat(s).sharesWith(a));
+}
+
+// Test the row-parallel kernels on a size that spans several chunks: workers
+// write through one row base fetched up front, never through the result matrix
+TEST_CASE("Row-parallel kernels on several chunks") {
+    const int n = 96;
+    SquareMat sym(n), b(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            sym[i][j] = (i + j) % 7 - 3;
+            b[i][j] = (i * 3 + j) % 5;
+        }
+    SquareMat fullSym(sym), lower = TriMat(sym, true).toSquareMat();
+    SquareMat got[3] = {SymMat(sym) * b, TriMat(sym, true) * b, minPlus(sym, b)};
+    SquareMat expected[3] = {fullSym * b, lower * b, SquareMat(n)};
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            double best = INFINITY;
+            for (int k = 0; k < n; ++k) best = std::min(best, fullSym[i][k] + b[k][j]);
+            expected[2][i][j] = best;
+        }
+    for (int t = 0; t < 3; ++t) {
+        CHECK(SquareMat(got[t]).sharesWith(got[t]));
+        const SquareMat& g = got[t];
+        int wrong = 0;
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j) wrong += g[i][j] != expected[t][i][j];
+        CHECK(wrong == 0);
+    }
+}
+
+// Test block views: operators, gemm into blocks and overlap detection
+TEST_CASE("Submatrix views") {
+    const int n = 4;
+    SquareMat a(n), b(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            a[i][j] = i * n + j;
+            b[i][j] = (i + j) % 3 - 1;
+        }
+    ConstMatView a11(a, 0, 0, 2), a12(a, 0, 2, 2), b11(b, 0, 0, 2), b21(b, 2, 0, 2);
+    CHECK(a12[1][0] == a[1][2]);
+    CHECK(a12.stride() == n);
+    CHECK(ConstMatView(a).sub(2, 2, 2)[1][1] == a[3][3]);
+
+    // top-left block of a*b from block products, written into a view of c
+    SquareMat c(n);
+    MatView c11(c, 0, 0, 2);
+    gemm(1.0, a11, b11, 0.0, c11);
+    gemm(1.0, a12, b21, 1.0, c11);
+    SquareMat full = a * b;
+    for (int i = 0; i < 2; ++i)
+        for (int j = 0; j < 2; ++j)
+            CHECK(c[i][j] == full[i][j]);
+    CHECK(c[2][2] == 0); // outside the block untouched
+
+    SquareMat sum = a11 + a12;
+    CHECK(sum[1][1] == a[1][1] + a[1][3]);
+    SquareMat prod = a11 * b11;
+    CHECK(prod[0][1] == a[0][0] * b[0][1] + a[0][1] * b[1][1]);
+
+    MatView whole(a);
+    MatView right(a, 0, 2, 2);
+    MatView below(a, 2, 0, 2);
+    CHECK_NOTHROW(gemm(1.0, below, ConstMatView(b, 0, 0, 2), 0.0, right)); // disjoint blocks of one matrix
+    CHECK_THROWS_AS(gemm(1.0, whole.sub(1, 1, 2), b11, 0.0, whole.sub(0, 0, 2)), std::invalid_argument);
+    CHECK_THROWS_AS(ConstMatView(a, 3, 3, 2), std::out_of_range);
+
+    SquareMat m(5); // determinant through column-list minors
+    for (int i = 0; i < 5; ++i)
+        for (int j = 0; j < 5; ++j) m[i][j] = (i == j) ? 2 : (i + j) % 2;
+    CHECK(!m == doctest::Approx(LU(m).determinant()));
+}
+
+// Test async operators and exception delivery through futures
+TEST_CASE("Asynchronous operators") {
+    SquareMat a(3), b(3);
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j) {
+            a[i][j] = i + j;
+            b[i][j] = (i == j) ? 2 : 0;
+        }
+    std::future<SquareMat> prod = multiply_async(a, b);
+    std::future<SquareMat> pow = power_async(a, 3);
+    std::future<double> det = determinant_async(b);
+    a[0][0] = 100; // does not affect work already submitted
+    SquareMat p = prod.get();
+    CHECK(p[1][2] == 6);
+    CHECK(p[0][0] == 0);
+    SquareMat expected(3);
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j) expected[i][j] = i + j;
+    SquareMat cube = expected * expected * expected;
+    CHECK(pow.get()[2][1] == cube[2][1]);
+    CHECK(det.get() == 8);
+
+    std::future<SquareMat> bad = power_async(a, -1);
+    CHECK_THROWS_AS(bad.get(), std::invalid_argument);
+
+    std::future<int> plain = ThreadPool::instance().submit([]() { return 7; });
+    CHECK(plain.get() == 7);
+}
+
+// Test lazy evaluation: shared subexpressions, transpose folding, chains
+TEST_CASE("Lazy expression DAG") {
+    const int n = 3;
+    SquareMat ma(n), mb(n), mc(n), md(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            ma[i][j] = i + 2 * j;
+            mb[i][j] = (i * j) % 3 - 1;
+            mc[i][j] = (i == j) ? 2 : 1;
+            md[i][j] = j - i;
+        }
+    LazyContext ctx;
+    Expr a = ctx.leaf(ma), b = ctx.leaf(mb);
+    SquareMat frozen(ma); // own values: ma handed out row pointers, frozen did not
+    CHECK(ctx.leaf(frozen).eval().sharesWith(frozen)); // the leaf shares its input
+    CHECK(ctx.leaf(frozen).eval().sharesWith(ctx.leaf(frozen).eval())); // same input, same leaf
+    Expr e = (a * b) + ((a * b) ^ 2) - ~(a * b);
+    CHECK(ctx.nodeCount() == 8); // frozen, a, b, a*b, ^2, +, ~, -: a*b recorded once
+    SquareMat ab = ma * mb;
+    SquareMat expected = ab + (ab ^ 2) - ~ab;
+    SquareMat got = e.eval();
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            CHECK(got[i][j] == expected[i][j]);
+
+    Expr c = ctx.leaf(mc), d = ctx.leaf(md);
+    SquareMat t = (~(a * c)).eval(); // single-use product computed transposed
+    SquareMat chain = (a * b * c * d).eval(); // balanced as (a*b)*(c*d)
+    SquareMat expectedT = ~(ma * mc);
+    SquareMat expectedChain = ma * mb * mc * md;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            CHECK(t[i][j] == expectedT[i][j]);
+            CHECK(chain[i][j] == expectedChain[i][j]);
+        }
+    CHECK((~~a).eval().sharesWith(a.eval()));
+    CHECK(((a + b) * 2.0).eval()[1][1] == 2 * (ma[1][1] + mb[1][1]));
+    int before = ctx.nodeCount();
+    Expr nan1 = a * NAN, nan2 = a * NAN; // NaN factors merge like any other
+    CHECK(ctx.nodeCount() == before + 1);
+    CHECK(std::isnan(nan2.eval()[0][0]));
+    Expr three = a * 3.0; // and leave the other keys findable
+    CHECK((a * 3.0).eval().sharesWith(three.eval()));
+    CHECK(ctx.nodeCount() == before + 2);
+    CHECK(std::isnan((nan1 + three).eval()[1][1]));
+    before = ctx.nodeCount();
+    ctx.leaf(ma);
+    CHECK(ctx.nodeCount() == before + 1); // ma was filled through []: no merge, a new leaf
+
+    Expr deep = a; // recording on another thread while this one evaluates
+    for (int k = 0; k < 20; ++k) deep = deep * b + a;
+    std::thread recorder([&]() {
+        Expr grow = b;
+        for (int k = 0; k < 500; ++k) grow = grow + ctx.leaf(frozen) * (k + 2.0);
+    });
+    SquareMat deepValue = deep.eval();
+    recorder.join();
+    SquareMat expectedDeep = ma;
+    for (int k = 0; k < 20; ++k) expectedDeep = expectedDeep * mb + ma;
+    int wrong = 0;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            if (deepValue[i][j] != expectedDeep[i][j]) ++wrong;
+    CHECK(wrong == 0);
+
+    LazyContext other;
+    CHECK_THROWS_AS(a + other.leaf(mb), std::invalid_argument);
+    CHECK_THROWS_AS((a * ctx.leaf(SquareMat(2))).eval(), std::invalid_argument);
+}
+
+// Test chain multiplication: sparse-aware order and the same result as left to right
+TEST_CASE("Matrix chain order") {
+    const int n = 20;
+    SquareMat a(n), b(n), x(n), d(n);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            a[i][j] = (i + 2 * j) % 7 - 3;
+            b[i][j] = (i * j) % 5 - 2;
+        }
+        x[i][0] = i + 1;   // a single nonzero column, like a vector
+        d[i][i] = i % 3 + 1;
+    }
+    std::vector<SquareMat> factors = {a, b, x};
+    CHECK(chain_order(factors) == "(0*(1*2))"); // b*x first, never the dense a*b
+    std::vector<SquareMat> deep = {a, d, a, a};
+    CHECK(chain_order(deep) == "(((0*1)*2)*3)"); // same work as ((0*1)*(2*3)), one temporary fewer
+    SquareMat got = chain_multiply(factors);
+    SquareMat expected = a * b * x;
+    std::vector<SquareMat> mixed = {d, a, x, d, b};
+    SquareMat gotMixed = chain_multiply(mixed);
+    SquareMat expectedMixed = d * a * x * d * b;
+    SquareMat gotDeep = chain_multiply(deep);
+    SquareMat expectedDeep = a * d * a * a;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            CHECK(got[i][j] == doctest::Approx(expected[i][j]));
+            CHECK(gotMixed[i][j] == doctest::Approx(expectedMixed[i][j]));
+            CHECK(gotDeep[i][j] == doctest::Approx(expectedDeep[i][j]));
+        }
+    CHECK(chain_multiply({a})[3][4] == a[3][4]);
+    bool saved = allocTrackingEnabled();
+    std::vector<SquareMat> pair = {a, b};
+    pair[0][0][0] += 1; // the inputs hand out rows: copying them would be deep
+    pair[1][0][0] += 1;
+    setAllocTracking(true);
+    resetAllocTracking();
+    SquareMat ab = chain_multiply(pair);
+    setAllocTracking(saved);
+    CHECK(peakBytes() < 2LL * n * n * 8); // the product only: the inputs are not copied again
+    resetAllocTracking();
+    CHECK_THROWS_AS(chain_multiply({}), std::invalid_argument);
+    CHECK_THROWS_AS(chain_multiply({a, SquareMat(2)}), std::invalid_argument);
+}
+
+// Test the work-stealing scheduler: nested task groups, errors, stats, determinant
+TEST_CASE("Work-stealing task groups") {
+    ThreadPool& pool = ThreadPool::instance();
+    pool.resetStats();
+    std::atomic<int> leaves(0);
+    std::function<void(int)> tree = [&](int depth) {
+        if (depth == 0) {
+            ++leaves;
+            return;
+        }
+        TaskGroup group;
+        for (int c = 0; c < depth; ++c) group.spawn([&tree, depth]() { tree(depth - 1); });
+        group.wait();
+    };
+    tree(5); // uneven: 5 * 4 * 3 * 2 * 1 leaves, spawned from inside tasks
+    CHECK(leaves.load() == 120);
+    std::vector<WorkerStats> stats = pool.stats();
+    CHECK(static_cast<int>(stats.size()) == pool.size());
+    for (size_t i = 0; i < stats.size(); ++i)
+        CHECK(stats[i].stolen <= stats[i].executed);
+
+    TaskGroup failing;
+    failing.spawn([]() { throw std::runtime_error("task failed"); });
+    failing.spawn([]() {});
+    CHECK_THROWS_AS(failing.wait(), std::runtime_error);
+    failing.wait(); // the error is reported once
+
+    const int n = 9;
+    SquareMat m(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            if ((i + 2 * j) % 4 != 0) m[i][j] = (i * j + 1) % 5 - 2; // zeros make uneven subtrees
+    int sign = 0;
+    double magnitude = LU(m).slogdet(sign);
+    CHECK(!m == doctest::Approx(sign * std::exp(magnitude)));
+}
+
+// Test NUMA topology queries and first-touch placement of a large matrix
+TEST_CASE("NUMA placement") {
+    std::vector<int> nodes = numaNodes();
+    REQUIRE(!nodes.empty());
+    std::vector<int> allowed = allowedCpus();
+    for (int w = 0; w < 4; ++w) {
+        int cpu = workerCpu(w);
+        if (cpu >= 0) CHECK(std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()); // inside the mask
+    }
+    const int n = 300; // large enough for the parallel zero fill
+    SquareMat m(n);
+    for (int i = 0; i < n; ++i)
+        CHECK(m[i][(i * 7) % n] == 0);
+    try {
+        std::vector<long> pages = pagesPerNode(m);
+        long total = 0;
+        for (size_t i = 0; i < pages.size(); ++i) total += pages[i];
+        CHECK(total > 0);
+        CHECK(total <= (static_cast<long>(n) * n * 8) / 4096 + 2);
+    } catch (const std::runtime_error&) {
+        // no move_pages here (e.g. a sandbox): nothing to report
+    }
+}
+
+// Test allocation policies: alignment, huge-page blocks and fallback, freeing
+TEST_CASE("Allocation policy") {
+    AllocPolicy saved = allocPolicy();
+    const int n = 600; // 2.9 MB of values, past one huge page
+    SquareMat small(8);
+    setAllocPolicy(ALLOC_ALIGNED);
+    SquareMat aligned(n);
+    CHECK(reinterpret_cast<uintptr_t>(aligned[0]) % VALUE_ALIGN == 0);
+    CHECK(allocKind(aligned[0]) == ALLOC_ALIGNED);
+    CHECK(aligned[1] == aligned[0] + n); // rows are packed: only the block start is aligned
+    setAllocPolicy(ALLOC_HUGE);
+    SquareMat huge(n);
+    CHECK(reinterpret_cast<uintptr_t>(huge[0]) % VALUE_ALIGN == 0);
+    CHECK(allocKind(huge[0]) == (hugePagesAvailable() ? ALLOC_HUGE : ALLOC_ALIGNED));
+    SquareMat tiny(4);
+    CHECK(allocKind(tiny[0]) == ALLOC_ALIGNED); // below one huge page
+    setAllocPolicy(ALLOC_PLAIN);
+    SquareMat plain(n);
+    CHECK(allocKind(plain[0]) == ALLOC_PLAIN);
+    for (int i = 0; i < n; ++i) {
+        aligned[i][i] = 1;
+        huge[i][(i + 1) % n] = 2;
+        plain[i][i] = 3;
+    }
+    SquareMat sum = aligned + huge + plain; // mixed kinds in one expression
+    CHECK(sum[5][5] == 4);
+    CHECK(sum[5][6] == 2);
+    SquareMat copy = huge;
+    copy[0][0] = 9; // copy-on-write takes a block under the current (plain) policy
+    CHECK(allocKind(copy[0]) == ALLOC_PLAIN);
+    CHECK(huge[0][0] == 0);
+    CHECK_THROWS_AS(SquareMat(2000000000), std::bad_alloc); // n * n * 8 bytes wraps size_t
+    setAllocPolicy(saved);
+    CHECK(small[7][7] == 0);
+}
+
+// Test operator profiling: off by default, counts, inclusive power, JSON dump
+TEST_CASE("Operator profiling") {
+    bool saved = profilingEnabled();
+    setProfiling(false);
+    resetProfile();
+    SquareMat a(5);
+    for (int i = 0; i < 5; ++i) a[i][i] = 2;
+    SquareMat ignored = a * a;
+    CHECK(operatorStats("*", 5).calls == 0);
+
+    setProfiling(true);
+    SquareMat p = a ^ 4; // squarings for each bit plus one result multiply: 4 products
+    SquareMat s = a + a;
+    double det = !a;
+    setProfiling(saved);
+    CHECK(sizeBucket(5) == 8);
+    CHECK(sizeBucket(8) == 8);
+    OpStats mul = operatorStats("*", 5);
+    OpStats pow = operatorStats("^", 7); // same bucket
+    CHECK(mul.calls == 4);
+    CHECK(mul.flops == 4 * 2.0 * 125);
+    CHECK(mul.bytes == 4 * 25 * 8);
+    CHECK(pow.calls == 1);
+    CHECK(pow.flops == mul.flops);      // inclusive of its multiplies
+    CHECK(pow.bytes >= mul.bytes);      // plus its identity matrix
+    CHECK(pow.seconds >= mul.seconds);
+    CHECK(operatorStats("+", 5).flops == 25);
+    CHECK(operatorStats("!", 5).calls == 1);
+    CHECK(operatorStats("*", 16).calls == 0); // other bucket
+    CHECK(det == 32);
+    CHECK(p[0][0] == 16);
+    CHECK(s[1][1] == 4);
+    std::string json = profileJson();
+    CHECK(json.find("{\"op\": \"^\", \"bucket\": 8, \"calls\": 1,") != std::string::npos);
+    CHECK(json.front() == '[');
+    CHECK(json.back() == ']');
+    resetProfile();
+    CHECK(profileJson() == "[]");
+}
+
+// Test Chrome trace export: operator and child events, balanced begin/end
+TEST_CASE("Chrome trace export") {
+    bool saved = tracingEnabled();
+    setTracing(true);
+    clearTrace();
+    const int n = 40;
+    SquareMat a(n);
+    for (int i = 0; i < n; ++i) a[i][(i + 1) % n] = 1;
+    SquareMat p = a ^ 5;
+    SquareMat c = chain_multiply({a, a, a});
+    setTracing(saved);
+    CHECK(p[0][5] == 1);
+    CHECK(c[0][3] == 1);
+    std::string json = traceJson();
+    CHECK(json.find("{\"traceEvents\": [") == 0);
+    CHECK(json.find("\"name\": \"^\", \"cat\": \"mat\", \"ph\": \"B\"") != std::string::npos);
+    CHECK(json.find("\"name\": \"power step\"") != std::string::npos);
+    CHECK(json.find("\"name\": \"gemm rows\"") != std::string::npos);
+    CHECK(json.find("\"name\": \"chain product\"") != std::string::npos);
+    CHECK(json.find("\"args\": {\"n\": 40, \"part\": 2}") != std::string::npos); // third power step
+    size_t begins = 0, ends = 0;
+    for (size_t at = json.find("\"ph\": \"B\""); at != std::string::npos; at = json.find("\"ph\": \"B\"", at + 1)) ++begins;
+    for (size_t at = json.find("\"ph\": \"E\""); at != std::string::npos; at = json.find("\"ph\": \"E\"", at + 1)) ++ends;
+    CHECK(begins > 0);
+    CHECK(begins == ends);
+    CHECK(json.find("e+") == std::string::npos); // fixed-point timestamps
+    size_t ts = json.find("\"ts\": ");
+    REQUIRE(ts != std::string::npos);
+    size_t dot = json.find('.', ts), comma = json.find(',', ts);
+    CHECK(comma - dot == 4); // three decimals
+
+    std::string path = "trace_test.json";
+    writeTrace(path);
+    std::ifstream file(path.c_str());
+    std::stringstream text;
+    text << file.rdbuf();
+    CHECK(text.str() == json + "\n");
+    std::remove(path.c_str());
+    CHECK_THROWS_AS(writeTrace("/nonexistent/dir/trace.json"), std::runtime_error);
+    clearTrace();
+    CHECK(traceJson() == "{\"traceEvents\": []}");
+}
+
+// Test allocation tracking: live and peak bytes, sites, largest temporaries
+TEST_CASE("Allocation tracking") {
+    bool saved = allocTrackingEnabled();
+    SquareMat before(10);
+    setAllocTracking(true);
+    resetAllocTracking();
+    const int n = 20;
+    const long long block = n * n * 8;
+    SquareMat a(n);
+    {
+        AllocSite site("setup");
+        SquareMat b(n);
+        CHECK(liveBytes() == 2 * block);
+    } // b freed: a temporary of "setup"
+    SquareMat c = (a + a) * a; // the sum is a temporary of "+"
+    SquareMat copy = c;
+    copy[0][0] = 1;            // copy-on-write outside any operator
+    setAllocTracking(saved);
+    CHECK(liveBlocks() == 3);  // a, c, copy
+    CHECK(liveBytes() == 3 * block);
+    CHECK(peakBytes() == 3 * block); // a, the sum and c; the sum is freed before the copy
+    std::map<std::string, SiteStats> sites = allocationsBySite();
+    CHECK(sites["(none)"].allocations == 2);
+    CHECK(sites["setup"].allocations == 1);
+    CHECK(sites["+"].bytes == block);
+    CHECK(sites["*"].largest == block);
+    std::vector<Temporary> temps = largestTemporaries();
+    REQUIRE(temps.size() == 2);
+    CHECK(temps[0].bytes == block);
+    CHECK((temps[0].site == "setup" || temps[0].site == "+"));
+    CHECK(temps[0].seconds >= 0);
+    std::string report = allocationReport();
+    CHECK(report.find("\"live_bytes\": 9600") != std::string::npos);
+    CHECK(report.find("{\"site\": \"setup\", \"allocations\": 1") != std::string::npos);
+    resetAllocTracking();
+    CHECK(liveBytes() == 0);
+
+    setAllocTracking(true); // pool tasks are charged where they were created
+    {
+        AllocSite outer("loop");
+        parallelFor(0, 64, 1, [](int lo, int hi) {
+            for (int i = lo; i < hi; ++i) SquareMat scratch(4);
+        });
+        ThreadPool::instance().submit([]() { SquareMat scratch(4); }).get();
+        TaskGroup group;
+        for (int t = 0; t < 8; ++t) group.spawn([]() { SquareMat scratch(4); });
+        AllocSite waiter("waiter"); // runs the tasks no worker took
+        group.wait();
+    }
+    setAllocTracking(saved);
+    sites = allocationsBySite();
+    CHECK(sites.size() == 1);
+    CHECK(sites["loop"].allocations == 64 + 8 + 1);
+    resetAllocTracking();
+}
+
+// Test that a lazy eval sharing a subexpression finishes while every pool
+// worker is busy: a waiting thread must not pick up a task that needs a node
+// it is computing
+TEST_CASE("Task group wait with busy workers") {
+    const int n = 4;
+    SquareMat ma(n), mb(n), mc(n), my(n), mz(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            ma[i][j] = i + j;
+            mb[i][j] = i - j;
+            mc[i][j] = (i == j) ? 2 : 0;
+            my[i][j] = (i * j) % 3;
+            mz[i][j] = j;
+        }
+    ThreadPool& pool = ThreadPool::instance();
+    std::promise<void> gate;
+    std::shared_future<void> open = gate.get_future().share();
+    std::vector<std::future<void>> busy;
+    for (int w = 0; w < pool.size(); ++w) busy.push_back(pool.submit([open]() { open.wait(); }));
+
+    LazyContext ctx;
+    Expr a = ctx.leaf(ma), b = ctx.leaf(mb), c = ctx.leaf(mc), y = ctx.leaf(my), z = ctx.leaf(mz);
+    Expr x = a * b * c;
+    SquareMat got = ((x * y) + (x * z)).eval();
+    gate.set_value();
+    for (size_t w = 0; w < busy.size(); ++w) busy[w].get();
+
+    SquareMat mx = ma * mb * mc;
+    SquareMat expected = mx * my + mx * mz;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            CHECK(got[i][j] == doctest::Approx(expected[i][j]));
+}
+
+// Test that multiplication keeps IEEE semantics: a zero times Inf or NaN is NaN
+TEST_CASE("Multiplication propagates Inf and NaN") {
+    SquareMat a(2), b(2);
+    a[0][1] = 1; // a[0][0] and row 1 are zero
+    b[0][0] = INFINITY;
+    b[0][1] = NAN;
+    b[1][0] = 2;
+    SquareMat c = a * b;
+    CHECK(std::isnan(c[0][0])); // 0 * Inf + 1 * 2
+    CHECK(std::isnan(c[0][1])); // 0 * NaN + 1 * 0
+    CHECK(std::isnan(c[1][0]));
+    SquareMat t(2);
+    gemm(1.0, a, b, 0.0, t, true, false);
+    CHECK(std::isnan(t[0][0])); // a^T[0][0] = 0 times Inf
+
+    Vector x(2); // the other kernels keep the same semantics
+    x[1] = 1;
+    CHECK(std::isnan((x * b)[0])); // 0 * Inf + 1 * 2
+    SquareMat sym = a + ~a;        // zero diagonal
+    CHECK(std::isnan((SymMat(sym) * b)[0][0]));
+    CHECK(std::isnan((TriMat(sym, true) * b)[0][0]));
+    SquareMat m(3); // the zero in row 0 multiplies a minor holding NaN
+    m[0][1] = 1;
+    m[1][0] = 1;
+    m[1][1] = NAN;
+    m[2][2] = 1;
+    CHECK(std::isnan(!m));
+    const int n = 20;
+    SquareMat dense(n), column(n); // sparse right operand, NaN on the left
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) dense[i][j] = i + j;
+        column[i][0] = 1;
+    }
+    dense[0][5] = NAN;
+    CHECK(std::isnan(chain_multiply({dense, column})[0][1])); // NaN * 0, as dense * column gives
+    CHECK(std::isnan((dense * column)[0][1]));
+}
+
+// Test that writes through a block view never reach copies taken after the view
+TEST_CASE("Views and copies") {
+    SquareMat m = SquareMat(4) + SquareMat(4);
+    MatView block(m, 1, 1, 2);
+    SquareMat before = m;
+    block[0][0] = 3;
+    block.sub(1, 1, 1)[0][0] = 4; // m[2][2]
+    const SquareMat& cm = m;
+    const SquareMat& cb = before;
+    CHECK(cm[1][1] == 3);
+    CHECK(cm[2][2] == 4);
+    CHECK(cb[1][1] == 0);
+    CHECK(cb[2][2] == 0);
+    CHECK_FALSE(before.sharesWith(m));
+}